@@ -0,0 +1,107 @@
+// Read scalability of THotState compared to std::atomic_load of a shared_ptr.
+// Usage: hot_state_benchmark [max_threads] [duration_ms]
+// Readers imitate the IO threads serving /threads, the writer imitates the clustering thread.
+
+#include "hot_state.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct TState {
+        uint64_t Generation = 0;
+    };
+
+    class TSharedPtrState {
+    public:
+        uint64_t Read() const {
+            return std::atomic_load(&StatePtr)->Generation;
+        }
+
+        void Set(std::shared_ptr<TState> state) {
+            std::atomic_store(&StatePtr, std::move(state));
+        }
+
+    private:
+        std::shared_ptr<TState> StatePtr;
+    };
+
+    class TPinnedState {
+    public:
+        uint64_t Read() const {
+            return State.Pin()->Generation;
+        }
+
+        void Set(std::shared_ptr<TState> state) {
+            State.AtomicSet(std::move(state));
+        }
+
+    private:
+        THotState<TState> State;
+    };
+
+    template<class TStateHolder>
+    double MeasureReads(size_t threadsCount, std::chrono::milliseconds duration) {
+        TStateHolder holder;
+        holder.Set(std::make_shared<TState>());
+
+        std::atomic<bool> stop {false};
+        std::atomic<uint64_t> totalReads {0};
+        std::vector<std::thread> readers;
+        for (size_t i = 0; i < threadsCount; ++i) {
+            readers.emplace_back([&]() {
+                uint64_t reads = 0;
+                uint64_t checksum = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    checksum += holder.Read();
+                    ++reads;
+                }
+                totalReads.fetch_add(reads + (checksum == UINT64_MAX), std::memory_order_relaxed);
+            });
+        }
+        std::thread writer([&]() {
+            uint64_t generation = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto state = std::make_shared<TState>();
+                state->Generation = ++generation;
+                holder.Set(std::move(state));
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+
+        std::this_thread::sleep_for(duration);
+        stop.store(true);
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        writer.join();
+
+        const double seconds = std::chrono::duration<double>(duration).count();
+        return static_cast<double>(totalReads.load()) / seconds / 1e6;
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t maxThreads = argc > 1 ? std::atoi(argv[1]) : std::max(std::thread::hardware_concurrency(), 1u);
+    const std::chrono::milliseconds duration(argc > 2 ? std::atoi(argv[2]) : 1000);
+
+    std::cout << std::setw(8) << "threads"
+        << std::setw(20) << "shared_ptr Mreads/s"
+        << std::setw(20) << "pinned Mreads/s" << std::endl;
+    for (size_t threadsCount = 1; threadsCount <= maxThreads; threadsCount *= 2) {
+        const double sharedPtrReads = MeasureReads<TSharedPtrState>(threadsCount, duration);
+        const double pinnedReads = MeasureReads<TPinnedState>(threadsCount, duration);
+        std::cout << std::setw(8) << threadsCount
+            << std::fixed << std::setprecision(2)
+            << std::setw(20) << sharedPtrReads
+            << std::setw(20) << pinnedReads << std::endl;
+    }
+    return 0;
+}
@@ -1,10 +1,22 @@
 #include "agency_rating.h"
+#include "host_interner.h"
 #include "util.h"
 
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <cmath>
+#include <iterator>
+#include <unordered_map>
+
+namespace {
+    const char* COUNTRY_CODES[CN_COUNT] = {"US", "GB", "IN", "RU", "CA", "AU"};
+}
+
+const char* ToCountryCode(ECountry country) {
+    return COUNTRY_CODES[country];
+}
 
 void TAgencyRating::Load(const std::string& filePath, bool setMinAsUnk) {
     std::string line;
@@ -13,60 +25,70 @@ void TAgencyRating::Load(const std::string& filePath, bool setMinAsUnk) {
         LOG_DEBUG("Rating file is not available");
         return;
     }
+    std::unordered_map<uint32_t, double> records;
     while (std::getline(rating, line)) {
         std::vector<std::string> lineSplitted;
         boost::split(lineSplitted, line, boost::is_any_of("\t"));
-        Records[lineSplitted[1]] = std::stod(lineSplitted[0]);
+        records[THostInterner::Instance().Intern(lineSplitted[1])] = std::stod(lineSplitted[0]);
     }
 
-    if (setMinAsUnk) {
-        UnkRating = std::min_element(Records.begin(), Records.end(),
-            [](const std::pair<std::string, double>& item1, const std::pair<std::string, double>& item2) {
+    if (setMinAsUnk && !records.empty()) {
+        UnkRating = std::min_element(records.begin(), records.end(),
+            [](const std::pair<uint32_t, double>& item1, const std::pair<uint32_t, double>& item2) {
                 return item1.second < item2.second;
             }
         )->second;
     }
+
+    Ratings.assign(THostInterner::Instance().Size(), UnkRating);
+    for (const auto& [hostId, value] : records) {
+        Ratings[hostId] = value;
+    }
 }
 
 double TAgencyRating::ScoreUrl(const std::string& url) const {
-    const auto iter = Records.find(GetHost(url));
-    return (iter != Records.end()) ? iter->second : UnkRating;
+    return ScoreHost(THostInterner::Instance().Find(GetHost(url)));
+}
+
+double TAgencyRating::ScoreHost(uint32_t hostId) const {
+    return hostId < Ratings.size() ? Ratings[hostId] : UnkRating;
 }
 
 void TAlexaAgencyRating::Load(const std::string& filePath) {
     std::ifstream fileStream(filePath);
     nlohmann::json json;
     fileStream >> json;
+    std::vector<std::pair<uint32_t, const nlohmann::json*>> agencies;
     for (const nlohmann::json& agency : json) {
-        std::string host = agency.at("host").get<std::string>();
-        double rating = agency.at("rating").get<double>();
-        RawRating[host] = rating;
+        const uint32_t hostId = THostInterner::Instance().Intern(agency.at("host").get<std::string>());
+        agencies.emplace_back(hostId, &agency);
+    }
 
-        for (auto& [key, value] : agency.at("country").items()) {
-            CountryShare[host][key] = value;
+    const size_t hostsCount = THostInterner::Instance().Size();
+    RawRatings.assign(hostsCount, UnkRating);
+    CountryShares.assign(hostsCount, std::array<double, CN_COUNT>{});
+    for (const auto& [hostId, agency] : agencies) {
+        RawRatings[hostId] = agency->at("rating").get<double>();
+        for (auto& [key, value] : agency->at("country").items()) {
+            const auto codeIt = std::find_if(std::begin(COUNTRY_CODES), std::end(COUNTRY_CODES),
+                [&key = key](const char* code) { return key == code; });
+            if (codeIt != std::end(COUNTRY_CODES)) {
+                CountryShares[hostId][std::distance(std::begin(COUNTRY_CODES), codeIt)] = value;
+            }
         }
     }
 }
 
-double TAlexaAgencyRating::GetCountryShare(const std::string& host, const std::string& code) const {
-    const auto iter = CountryShare.find(host);
-    if (iter == CountryShare.end()) {
-        return 0.;
-    }
-    const auto iter2 = iter->second.find(code);
-    if (iter2 == iter->second.end()) {
-        return 0.;
-    }
-    return iter2->second;
+double TAlexaAgencyRating::GetCountryShare(uint32_t hostId, ECountry country) const {
+    return hostId < CountryShares.size() ? CountryShares[hostId][country] : 0.;
 }
 
-double TAlexaAgencyRating::GetRawRating(const std::string& host) const {
-    const auto iter = RawRating.find(host);
-    return (iter != RawRating.end()) ? iter->second : UnkRating;
+double TAlexaAgencyRating::GetRawRating(uint32_t hostId) const {
+    return hostId < RawRatings.size() ? RawRatings[hostId] : UnkRating;
 }
 
-double TAlexaAgencyRating::ScoreUrl(
-    const std::string& host,
+double TAlexaAgencyRating::ScoreHost(
+    uint32_t hostId,
     tg::ELanguage language,
     ERatingType type,
     double shift
@@ -74,12 +96,12 @@ double TAlexaAgencyRating::ScoreUrl(
     if (type == RT_ONE) {
         return 1.;
     }
-    double raw = GetRawRating(host);
+    double raw = GetRawRating(hostId);
     double coeff = 0;
     if (language == tg::LN_EN) {
-        coeff = (100. - GetCountryShare(host, "US") - GetCountryShare(host, "GB"))/100.;
+        coeff = (100. - GetCountryShare(hostId, CN_US) - GetCountryShare(hostId, CN_GB))/100.;
     } else {
-        coeff = GetCountryShare(host, "RU");
+        coeff = GetCountryShare(hostId, CN_RU);
     }
     if (type == RT_LOG) {
         return std::max(log(raw * coeff + shift), 0.3);
@@ -2,10 +2,14 @@
 
 #include "enum.pb.h"
 
+#include <array>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
+#include <vector>
 #include <nlohmann_json/json.hpp>
 
+// Ratings are flat arrays indexed by THostInterner ids
+
 class TAgencyRating {
 public:
     TAgencyRating() = default;
@@ -15,9 +19,10 @@ public:
 
     void Load(const std::string& fileName, bool setMinAsUnk = false);
     double ScoreUrl(const std::string& url) const;
+    double ScoreHost(uint32_t hostId) const;
 
 private:
-     std::unordered_map<std::string, double> Records;
+     std::vector<double> Ratings;
      double UnkRating = 0.000015;
 };
 
@@ -27,6 +32,18 @@ enum ERatingType {
     RT_ONE = 2
 };
 
+enum ECountry {
+    CN_US = 0,
+    CN_GB = 1,
+    CN_IN = 2,
+    CN_RU = 3,
+    CN_CA = 4,
+    CN_AU = 5,
+    CN_COUNT = 6
+};
+
+const char* ToCountryCode(ECountry country);
+
 class TAlexaAgencyRating {
 public:
     TAlexaAgencyRating() = default;
@@ -35,12 +52,12 @@ public:
     }
 
     void Load(const std::string& fileName);
-    double ScoreUrl(const std::string& host, tg::ELanguage language, ERatingType type, double shift) const;
-    double GetRawRating(const std::string& host) const;
-    double GetCountryShare(const std::string& host, const std::string& code) const;
+    double ScoreHost(uint32_t hostId, tg::ELanguage language, ERatingType type, double shift) const;
+    double GetRawRating(uint32_t hostId) const;
+    double GetCountryShare(uint32_t hostId, ECountry country) const;
 
 private:
-     std::unordered_map<std::string, double> RawRating;
-     std::unordered_map<std::string, std::unordered_map<std::string, double>> CountryShare;
+     std::vector<double> RawRatings;
+     std::vector<std::array<double, CN_COUNT>> CountryShares;
      double UnkRating = 0.1;
 };
@@ -0,0 +1,149 @@
+#include "annotation_executor.h"
+#include "document.h"
+#include "util.h"
+
+#include <tinyxml2/tinyxml2.h>
+
+TAnnotationExecutor::TAnnotationExecutor(
+    std::unique_ptr<TAnnotator> annotator,
+    size_t batchSize,
+    std::chrono::microseconds batchTimeout,
+    size_t threadsCount,
+    size_t maxQueueSize
+)
+    : Annotator(std::move(annotator))
+    , BatchSize(std::max(batchSize, static_cast<size_t>(1)))
+    , BatchTimeout(batchTimeout)
+    , MaxQueueSize(maxQueueSize)
+{
+    ENSURE(Annotator, "Annotation executor without annotator");
+    threadsCount = std::max(threadsCount, static_cast<size_t>(1));
+    for (size_t i = 0; i < threadsCount; ++i) {
+        Threads.emplace_back(&TAnnotationExecutor::Work, this);
+    }
+}
+
+TAnnotationExecutor::~TAnnotationExecutor() {
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        IsDone = true;
+    }
+    Condition.notify_all();
+    for (std::thread& thread : Threads) {
+        thread.join();
+    }
+}
+
+bool TAnnotationExecutor::Annotate(std::string html, std::string fileName, TCallback&& callback) {
+    size_t queueSize = 0;
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        if (MaxQueueSize != 0 && Requests.size() >= MaxQueueSize) {
+            return false;
+        }
+        Requests.push_back({std::move(html), std::move(fileName), std::move(callback), TClock::now()});
+        queueSize = Requests.size();
+    }
+    // Workers are woken up on the first request to start the timer and on a full batch to flush it
+    if (queueSize == 1 || queueSize >= BatchSize) {
+        Condition.notify_one();
+    }
+    return true;
+}
+
+void TAnnotationExecutor::Work() {
+    while (true) {
+        std::vector<TRequest> batch;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Condition.wait(lock, [this] { return IsDone || !Requests.empty(); });
+            if (Requests.empty()) {
+                return;
+            }
+            const TClock::time_point deadline = Requests.front().EnqueueTime + BatchTimeout;
+            Condition.wait_until(lock, deadline, [this] { return IsDone || Requests.size() >= BatchSize || Requests.empty(); });
+            if (Requests.empty()) {
+                continue;
+            }
+            const size_t batchSize = std::min(BatchSize, Requests.size());
+            batch.reserve(batchSize);
+            for (size_t i = 0; i < batchSize; ++i) {
+                batch.push_back(std::move(Requests.front()));
+                Requests.pop_front();
+            }
+        }
+        // Let another worker pick up the rest of the queue
+        Condition.notify_one();
+        ProcessBatch(batch);
+    }
+}
+
+void TAnnotationExecutor::ProcessBatch(std::vector<TRequest>& batch) const {
+    std::vector<TResult> results(batch.size());
+    std::vector<TDocument> documents;
+    std::vector<size_t> documentsRequests;
+    documents.reserve(batch.size());
+    documentsRequests.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        tinyxml2::XMLDocument html;
+        const tinyxml2::XMLError parseCode = html.Parse(batch[i].Html.data(), batch[i].Html.size());
+        if (parseCode != tinyxml2::XML_SUCCESS) {
+            continue;
+        }
+        try {
+            std::optional<TDocument> document = Annotator->ParseHtml(html, batch[i].FileName);
+            if (!document) {
+                continue;
+            }
+            documents.push_back(std::move(document.value()));
+            documentsRequests.push_back(i);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Parsing of " << batch[i].FileName << " failed: " << e.what());
+            results[i].Failed = true;
+        } catch (...) {
+            LOG_ERROR("Parsing of " << batch[i].FileName << " failed");
+            results[i].Failed = true;
+        }
+    }
+
+    std::vector<TResult> annotatedDocs = AnnotateBatch(documents);
+    for (size_t i = 0; i < annotatedDocs.size(); ++i) {
+        results[documentsRequests[i]] = std::move(annotatedDocs[i]);
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        try {
+            batch[i].Callback(std::move(results[i]));
+        } catch (const std::exception& e) {
+            LOG_ERROR("Annotation callback of " << batch[i].FileName << " failed: " << e.what());
+        } catch (...) {
+            LOG_ERROR("Annotation callback of " << batch[i].FileName << " failed");
+        }
+    }
+}
+
+std::vector<TAnnotationExecutor::TResult> TAnnotationExecutor::AnnotateBatch(const std::vector<TDocument>& documents) const {
+    std::vector<TResult> results(documents.size());
+    try {
+        std::vector<std::optional<TDbDocument>> dbDocs = Annotator->AnnotateDocuments(documents);
+        for (size_t i = 0; i < dbDocs.size(); ++i) {
+            results[i].Document = std::move(dbDocs[i]);
+        }
+        return results;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Annotation of a batch failed: " << e.what());
+    } catch (...) {
+        LOG_ERROR("Annotation of a batch failed");
+    }
+    if (documents.size() == 1) {
+        results[0].Failed = true;
+        return results;
+    }
+
+    // One document should not fail the others, they are retried one by one
+    for (size_t i = 0; i < documents.size(); ++i) {
+        std::vector<TResult> result = AnnotateBatch({documents[i]});
+        results[i] = std::move(result[0]);
+    }
+    return results;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "annotator.h"
+#include "db_document.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Annotates documents from the HTTP handlers outside of the IO threads.
+// Queued documents are flushed as one batch after BatchSize documents or BatchTimeout since the oldest one.
+class TAnnotationExecutor {
+public:
+    struct TResult {
+        // std::nullopt means bad html
+        std::optional<TDbDocument> Document;
+        // Annotation failed on the server side, the document is not necessarily bad
+        bool Failed = false;
+    };
+    using TCallback = std::function<void(TResult&&)>;
+
+    TAnnotationExecutor(
+        std::unique_ptr<TAnnotator> annotator,
+        size_t batchSize,
+        std::chrono::microseconds batchTimeout,
+        size_t threadsCount,
+        size_t maxQueueSize = 0
+    );
+    ~TAnnotationExecutor();
+
+    // Callback is called from an executor thread, it should not block on the IO loops and should be thread-safe.
+    // Exceptions of the callback are logged and ignored.
+    // Returns false without calling the callback if maxQueueSize documents are already queued.
+    bool Annotate(std::string html, std::string fileName, TCallback&& callback);
+
+private:
+    using TClock = std::chrono::steady_clock;
+
+    struct TRequest {
+        std::string Html;
+        std::string FileName;
+        TCallback Callback;
+        TClock::time_point EnqueueTime;
+    };
+
+    void Work();
+    void ProcessBatch(std::vector<TRequest>& batch) const;
+    std::vector<TResult> AnnotateBatch(const std::vector<TDocument>& documents) const;
+
+private:
+    const std::unique_ptr<TAnnotator> Annotator;
+    const size_t BatchSize;
+    const std::chrono::microseconds BatchTimeout;
+    const size_t MaxQueueSize;
+
+    std::deque<TRequest> Requests;
+    std::mutex Mutex;
+    std::condition_variable Condition;
+    bool IsDone = false;
+
+    std::vector<std::thread> Threads;
+};
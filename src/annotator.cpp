@@ -1,22 +1,28 @@
 #include "annotator.h"
+#include "bounded_queue.h"
 #include "detect.h"
 #include "document.h"
+#include "document_archive.h"
 #include "embedders/ft_embedder.h"
 #include "embedders/tfidf_embedder.h"
 #include "embedders/torch_embedder.h"
+#include "mapped_file.h"
 #include "nasty.h"
-#include "thread_pool.h"
+#include "record_reader.h"
 #include "timer.h"
 #include "util.h"
 
-#include <boost/algorithm/string/join.hpp>
 #include <tinyxml2/tinyxml2.h>
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
 #include <optional>
+#include <thread>
 
-static std::unique_ptr<TEmbedder> LoadEmbedder(tg::TEmbedderConfig config) {
+static std::unique_ptr<TEmbedder> LoadEmbedder(tg::TEmbedderConfig config, TFTVectorModelStorage& vectorModels) {
     if (config.type() == tg::ET_FASTTEXT) {
-        return std::make_unique<TFastTextEmbedder>(config);
+        return std::make_unique<TFastTextEmbedder>(config, &vectorModels);
     } else if (config.type() == tg::ET_TORCH) {
         return std::make_unique<TTorchEmbedder>(config);
     } else if (config.type() == tg::ET_TFIDF) {
@@ -26,6 +32,17 @@ static std::unique_ptr<TEmbedder> LoadEmbedder(tg::TEmbedderConfig config) {
     }
 }
 
+// Unreadable files are skipped like bad html
+static std::optional<TMappedFile> MapHtml(const std::string& path) {
+    try {
+        // One open per file, the whole file is read at once in the worker
+        return TMappedFile(path, /* populate */ true);
+    } catch (...) {
+        LOG_DEBUG("Bad html: " << path);
+        return std::nullopt;
+    }
+}
+
 TAnnotator::TAnnotator(
     const std::string& configPath,
     const std::vector<std::string>& languages,
@@ -40,6 +57,7 @@ TAnnotator::TAnnotator(
     SaveTexts = Config.save_texts() || (Mode == "json");
     SaveNotNews = Config.save_not_news() || SaveNotNews;
     ComputeNasty = Config.compute_nasty();
+    EmbeddingBatchSize = Config.embedding_batch_size() != 0 ? Config.embedding_batch_size() : 128;
 
     LOG_DEBUG("Loading models...");
 
@@ -61,13 +79,15 @@ TAnnotator::TAnnotator(
         LOG_DEBUG("FastText " << ToString(language) << " category detector loaded");
     }
 
+    // Embedders with the same vector_model_path share one loaded model
+    TFTVectorModelStorage vectorModels;
     for (const auto& embedderConfig : Config.embedders()) {
         tg::ELanguage language = embedderConfig.language();
         if (Languages.find(language) == Languages.end()) {
             continue;
         }
         tg::EEmbeddingKey embeddingKey = embedderConfig.embedding_key();
-        Embedders[{language, embeddingKey}] = LoadEmbedder(embedderConfig);
+        Embedders[{language, embeddingKey}] = LoadEmbedder(embedderConfig, vectorModels);
     }
 }
 
@@ -75,69 +95,182 @@ std::vector<TDbDocument> TAnnotator::AnnotateAll(
     const std::vector<std::string>& fileNames,
     tg::EInputFormat inputFormat) const
 {
-    TThreadPool threadPool;
     std::vector<TDbDocument> docs;
-    std::vector<std::future<std::optional<TDbDocument>>> futures;
-    if (inputFormat == tg::IF_JSON) {
-        std::vector<TDocument> parsedDocs;
-        for (const std::string& path: fileNames) {
-            std::ifstream fileStream(path);
-            nlohmann::json json;
-            fileStream >> json;
-            for (const nlohmann::json& obj : json) {
-                parsedDocs.emplace_back(obj);
+    AnnotateStream(fileNames, inputFormat, [&docs](TDbDocument&& doc) {
+        docs.push_back(std::move(doc));
+    });
+    docs.shrink_to_fit();
+    return docs;
+}
+
+void TAnnotator::AnnotateStream(
+    const std::vector<std::string>& fileNames,
+    tg::EInputFormat inputFormat,
+    const std::function<void(TDbDocument&&)>& sink) const
+{
+    // Reader (this thread) -> annotation workers -> ordered sink.
+    // The number of chunks between the reader and the sink is limited, so the reader waits for slow chunks
+    // and the memory does not depend on the input size.
+    const size_t workersCount = std::max(std::thread::hardware_concurrency(), 1u);
+    const size_t maxChunksInFlight = 2 * workersCount;
+
+    TBoundedQueue<TRecordsChunk> chunks(maxChunksInFlight);
+
+    std::mutex sinkMutex;
+    std::condition_variable sinkCondition;
+    std::map<size_t, std::vector<TDbDocument>> annotatedChunks;
+    size_t nextSinkChunk = 0;
+    std::exception_ptr error;
+    const auto fail = [&](std::exception_ptr exception) {
+        {
+            std::lock_guard<std::mutex> lock(sinkMutex);
+            if (!error) {
+                error = exception;
             }
         }
-        parsedDocs.shrink_to_fit();
-        docs.reserve(parsedDocs.size());
-        futures.reserve(parsedDocs.size());
-        for (const TDocument& parsedDoc: parsedDocs) {
-            futures.push_back(threadPool.enqueue(&TAnnotator::AnnotateDocument, this, parsedDoc));
-        }
-    } else if (inputFormat == tg::IF_JSONL) {
-        std::vector<TDocument> parsedDocs;
-        for (const std::string& path: fileNames) {
-            std::ifstream fileStream(path);
+        sinkCondition.notify_all();
+        chunks.Close();
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(workersCount);
+    for (size_t i = 0; i < workersCount; ++i) {
+        workers.emplace_back([&]() {
+            try {
+                while (std::optional<TRecordsChunk> chunk = chunks.Pop()) {
+                    std::vector<TDbDocument> docs = AnnotateRecords(*chunk, inputFormat);
+                    std::lock_guard<std::mutex> lock(sinkMutex);
+                    annotatedChunks.emplace(chunk->Index, std::move(docs));
+                    // Chunks are passed to the sink in the input order
+                    auto it = annotatedChunks.begin();
+                    while (it != annotatedChunks.end() && it->first == nextSinkChunk) {
+                        for (TDbDocument& doc : it->second) {
+                            sink(std::move(doc));
+                        }
+                        it = annotatedChunks.erase(it);
+                        ++nextSinkChunk;
+                    }
+                    sinkCondition.notify_all();
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        });
+    }
+
+    // Archived htmls are read by the workers right from the mappings, so archives live until the workers are joined
+    std::vector<std::unique_ptr<TDocumentArchive>> archives;
+    try {
+        size_t chunksCount = 0;
+        const auto pushChunk = [&](TRecordsChunk&& chunk) {
+            {
+                std::unique_lock<std::mutex> lock(sinkMutex);
+                sinkCondition.wait(lock, [&] { return error || chunksCount - nextSinkChunk < maxChunksInFlight; });
+                if (error) {
+                    return false;
+                }
+            }
+            chunk.Index = chunksCount++;
+            return chunks.Push(std::move(chunk));
+        };
+        if (inputFormat == tg::IF_ARCHIVE) {
+            // Archives are sharded by offsets: a chunk is a range of consecutive documents
+            bool isStopped = false;
+            for (size_t fileIndex = 0; fileIndex < fileNames.size() && !isStopped; ++fileIndex) {
+                archives.push_back(std::make_unique<TDocumentArchive>(fileNames[fileIndex]));
+                const TDocumentArchive& archive = *archives.back();
+                for (size_t begin = 0; begin < archive.Size() && !isStopped; begin += EmbeddingBatchSize) {
+                    const size_t end = std::min(begin + EmbeddingBatchSize, archive.Size());
+                    archive.Prefetch(begin, end);
+                    TRecordsChunk chunk;
+                    chunk.Records.reserve(end - begin);
+                    chunk.ArchivedHtmls.reserve(end - begin);
+                    for (size_t i = begin; i < end; ++i) {
+                        chunk.Records.emplace_back(archive.GetName(i));
+                        chunk.ArchivedHtmls.push_back(archive.GetData(i));
+                    }
+                    isStopped = !pushChunk(std::move(chunk));
+                }
+            }
+        } else {
+            TRecordReader reader(fileNames, inputFormat);
+            TRecordsChunk chunk;
             std::string record;
-            while (std::getline(fileStream, record)) {
-                parsedDocs.emplace_back(nlohmann::json::parse(record));
+            while (reader.Next(&record)) {
+                chunk.Records.push_back(std::move(record));
+                if (chunk.Records.size() >= EmbeddingBatchSize) {
+                    if (!pushChunk(std::move(chunk))) {
+                        break;
+                    }
+                    chunk = TRecordsChunk();
+                }
+            }
+            if (!chunk.Records.empty()) {
+                pushChunk(std::move(chunk));
             }
         }
-        parsedDocs.shrink_to_fit();
-        docs.reserve(parsedDocs.size());
-        futures.reserve(parsedDocs.size());
-        for (const TDocument& parsedDoc: parsedDocs) {
-            futures.push_back(threadPool.enqueue(&TAnnotator::AnnotateDocument, this, parsedDoc));
-        }
-    } else if (inputFormat == tg::IF_HTML) {
-        docs.reserve(fileNames.size());
-        futures.reserve(fileNames.size());
-        for (const std::string& path: fileNames) {
-            using TFunc = std::optional<TDbDocument>(TAnnotator::*)(const std::string&) const;
-            futures.push_back(threadPool.enqueue<TFunc>(&TAnnotator::AnnotateHtml, this, path));
-        }
-    } else {
-        ENSURE(false, "Bad input format");
+    } catch (...) {
+        fail(std::current_exception());
+    }
+    chunks.Close();
+    for (std::thread& worker : workers) {
+        worker.join();
     }
-    for (auto& futureDoc : futures) {
-        std::optional<TDbDocument> doc = futureDoc.get();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::vector<TDbDocument> TAnnotator::AnnotateRecords(
+    const TRecordsChunk& chunk,
+    tg::EInputFormat inputFormat) const
+{
+    const std::vector<std::string>& records = chunk.Records;
+    std::vector<TPreparedDocument> preparedDocs;
+    preparedDocs.reserve(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        std::optional<TPreparedDocument> doc;
+        if (inputFormat != tg::IF_HTML && inputFormat != tg::IF_ARCHIVE) {
+            doc = PrepareDocument(TDocument(nlohmann::json::parse(records[i])));
+        } else if (inputFormat == tg::IF_ARCHIVE) {
+            doc = PrepareHtml(chunk.ArchivedHtmls[i], records[i]);
+        } else if (const std::optional<TMappedFile> file = MapHtml(records[i])) {
+            doc = PrepareHtml(std::string_view(file->Data(), file->Size()), records[i]);
+        }
         if (!doc) {
             continue;
         }
-        if (Languages.find(doc->Language) == Languages.end()) {
+        if (Languages.find(doc->Doc.Language) == Languages.end()) {
             continue;
         }
-        if (!doc->IsFullyIndexed()) {
+        if (!doc->Doc.IsNews() && !SaveNotNews) {
             continue;
         }
-        if (!doc->IsNews() && !SaveNotNews) {
-            continue;
+        preparedDocs.push_back(std::move(doc.value()));
+    }
+
+    // Embedders are run on batches of documents of the same language
+    std::map<tg::ELanguage, std::vector<TPreparedDocument*>> lang2Docs;
+    for (TPreparedDocument& doc : preparedDocs) {
+        if (doc.NeedsEmbeddings) {
+            lang2Docs[doc.Doc.Language].push_back(&doc);
         }
+    }
+    for (const auto& [language, langDocs] : lang2Docs) {
+        for (size_t batchStart = 0; batchStart < langDocs.size(); batchStart += EmbeddingBatchSize) {
+            const size_t batchEnd = std::min(batchStart + EmbeddingBatchSize, langDocs.size());
+            CalcEmbeddings(std::vector<TPreparedDocument*>(langDocs.begin() + batchStart, langDocs.begin() + batchEnd));
+        }
+    }
 
-        docs.push_back(std::move(doc.value()));
+    std::vector<TDbDocument> docs;
+    docs.reserve(preparedDocs.size());
+    for (TPreparedDocument& doc : preparedDocs) {
+        if (!doc.Doc.IsFullyIndexed()) {
+            continue;
+        }
+        docs.push_back(std::move(doc.Doc));
     }
-    futures.clear();
-    docs.shrink_to_fit();
     return docs;
 }
 
@@ -152,7 +285,48 @@ std::optional<TDbDocument> TAnnotator::AnnotateHtml(const tinyxml2::XMLDocument&
 }
 
 std::optional<TDbDocument> TAnnotator::AnnotateDocument(const TDocument& document) const {
-    TDbDocument dbDoc;
+    std::optional<TPreparedDocument> preparedDoc = PrepareDocument(document);
+    if (!preparedDoc) {
+        return std::nullopt;
+    }
+    if (preparedDoc->NeedsEmbeddings) {
+        CalcEmbeddings({&preparedDoc.value()});
+    }
+    return std::move(preparedDoc->Doc);
+}
+
+std::vector<std::optional<TDbDocument>> TAnnotator::AnnotateDocuments(const std::vector<TDocument>& documents) const {
+    std::vector<std::optional<TPreparedDocument>> preparedDocs;
+    preparedDocs.reserve(documents.size());
+    std::map<tg::ELanguage, std::vector<TPreparedDocument*>> lang2Docs;
+    for (const TDocument& document : documents) {
+        preparedDocs.push_back(PrepareDocument(document));
+    }
+    for (std::optional<TPreparedDocument>& doc : preparedDocs) {
+        if (doc && doc->NeedsEmbeddings) {
+            lang2Docs[doc->Doc.Language].push_back(&doc.value());
+        }
+    }
+    for (const auto& [language, langDocs] : lang2Docs) {
+        CalcEmbeddings(langDocs);
+    }
+
+    std::vector<std::optional<TDbDocument>> dbDocs;
+    dbDocs.reserve(preparedDocs.size());
+    for (std::optional<TPreparedDocument>& doc : preparedDocs) {
+        dbDocs.push_back(doc ? std::make_optional(std::move(doc->Doc)) : std::nullopt);
+    }
+    return dbDocs;
+}
+
+std::optional<TAnnotator::TPreparedDocument> TAnnotator::PrepareHtml(std::string_view html, const std::string& path) const {
+    std::optional<TDocument> parsedDoc = ParseHtml(html.data(), html.size(), path);
+    return parsedDoc ? PrepareDocument(*parsedDoc) : std::nullopt;
+}
+
+std::optional<TAnnotator::TPreparedDocument> TAnnotator::PrepareDocument(const TDocument& document) const {
+    TPreparedDocument preparedDoc;
+    TDbDocument& dbDoc = preparedDoc.Doc;
     dbDoc.Language = DetectLanguage(LanguageDetector, document);
     dbDoc.Url = document.Url;
     dbDoc.Host = GetHost(dbDoc.Url);
@@ -169,34 +343,55 @@ std::optional<TDbDocument> TAnnotator::AnnotateDocument(const TDocument& documen
     }
 
     if (Mode == "languages") {
-        return dbDoc;
+        return preparedDoc;
     }
 
     if (document.Text.length() < Config.min_text_length()) {
-        return dbDoc;
+        return preparedDoc;
     }
 
-    std::string cleanTitle = PreprocessText(document.Title);
-    std::string cleanText = PreprocessText(document.Text);
+    // Tokenized once, the classifier and all embedders read the same stream
+    PreprocessText(document.Title, &preparedDoc.Tokens);
+    PreprocessText(document.Text, &preparedDoc.Tokens);
 
     auto detectorIt = CategoryDetectors.find(dbDoc.Language);
     if (detectorIt != CategoryDetectors.end()) {
         const auto& detector = detectorIt->second;
-        dbDoc.Category = DetectCategory(detector, cleanTitle, cleanText);
+        dbDoc.Category = DetectCategory(detector, preparedDoc.Tokens.GetText());
+    }
+    preparedDoc.NeedsEmbeddings = true;
+    if (ComputeNasty) {
+        dbDoc.Nasty = ComputeDocumentNasty(dbDoc);
+    }
+
+    return preparedDoc;
+}
+
+void TAnnotator::CalcEmbeddings(const std::vector<TPreparedDocument*>& batch) const {
+    if (batch.empty()) {
+        return;
     }
+    const tg::ELanguage batchLanguage = batch.front()->Doc.Language;
     for (const auto& [pair, embedder]: Embedders) {
         const auto& [language, embeddingKey] = pair;
-        if (language != dbDoc.Language) {
+        if (language != batchLanguage) {
             continue;
         }
-        TDbDocument::TEmbedding value = embedder->CalcEmbedding(cleanTitle, cleanText);
-        dbDoc.Embeddings.emplace(embeddingKey, std::move(value));
+        std::vector<TEmbedderInput> inputs;
+        inputs.reserve(batch.size());
+        for (TPreparedDocument* doc : batch) {
+            assert(doc->Doc.Language == batchLanguage);
+            inputs.push_back(embedder->MakeInput(doc->Tokens, &doc->WordVectors));
+        }
+        std::vector<TDbDocument::TEmbedding> values = embedder->CalcEmbeddings(inputs);
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch[i]->Doc.Embeddings.emplace(embeddingKey, std::move(values[i]));
+        }
     }
-    if (ComputeNasty) {
-        dbDoc.Nasty = ComputeDocumentNasty(dbDoc);
+    // The vectors are not needed after the last embedder
+    for (TPreparedDocument* doc : batch) {
+        doc->WordVectors.Clear();
     }
-
-    return dbDoc;
 }
 
 std::optional<TDocument> TAnnotator::ParseHtml(const std::string& path) const {
@@ -210,6 +405,17 @@ std::optional<TDocument> TAnnotator::ParseHtml(const std::string& path) const {
     return doc;
 }
 
+std::optional<TDocument> TAnnotator::ParseHtml(const char* data, size_t size, const std::string& fileName) const {
+    TDocument doc;
+    try {
+        doc.FromHtmlBuffer(data, size, fileName, Config.parse_links());
+    } catch (...) {
+        LOG_DEBUG("Bad html: " << fileName);
+        return std::nullopt;
+    }
+    return doc;
+}
+
 std::optional<TDocument> TAnnotator::ParseHtml(const tinyxml2::XMLDocument& html, const std::string& fileName) const {
     TDocument doc;
     try {
@@ -221,8 +427,10 @@ std::optional<TDocument> TAnnotator::ParseHtml(const tinyxml2::XMLDocument& html
     return doc;
 }
 
-std::string TAnnotator::PreprocessText(const std::string& text) const {
-    std::vector<std::string> tokens;
-    Tokenizer.tokenize(text, tokens);
-    return boost::join(tokens, " ");
+void TAnnotator::PreprocessText(const std::string& text, TTokenStream* tokens) const {
+    // The vector is reused by the thread, tokens are short and mostly fit into the small string buffers
+    static thread_local std::vector<std::string> textTokens;
+    textTokens.clear();
+    Tokenizer.tokenize(text, textTokens);
+    tokens->AddField(textTokens);
 }
@@ -3,9 +3,13 @@
 #include "config.pb.h"
 #include "db_document.h"
 #include "embedders/embedder.h"
+#include "embedders/word_vector_cache.h"
+#include "token_stream.h"
 
+#include <functional>
 #include <memory>
 #include <optional>
+#include <string_view>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
@@ -29,18 +33,50 @@ public:
         bool saveNotNews = false,
         const std::string& mode = "top");
 
+    // For IF_ARCHIVE file names are paths of TDocumentArchive files
     std::vector<TDbDocument> AnnotateAll(const std::vector<std::string>& fileNames, tg::EInputFormat inputFormat) const;
+    // Documents are read, annotated and passed to the sink in the input order with a bounded number of them in memory.
+    // The sink is called from the annotation threads, but never concurrently.
+    void AnnotateStream(
+        const std::vector<std::string>& fileNames,
+        tg::EInputFormat inputFormat,
+        const std::function<void(TDbDocument&&)>& sink) const;
 
     std::optional<TDbDocument> AnnotateHtml(const std::string& path) const;
     std::optional<TDbDocument> AnnotateHtml(const tinyxml2::XMLDocument& html, const std::string& fileName) const;
 
-private:
-    std::optional<TDbDocument> AnnotateDocument(const TDocument& document) const;
+    // Embeddings are calculated for the whole batch at once, results keep the input order
+    std::vector<std::optional<TDbDocument>> AnnotateDocuments(const std::vector<TDocument>& documents) const;
 
     std::optional<TDocument> ParseHtml(const std::string& path) const;
+    std::optional<TDocument> ParseHtml(const char* data, size_t size, const std::string& fileName) const;
     std::optional<TDocument> ParseHtml(const tinyxml2::XMLDocument& html, const std::string& fileName) const;
 
-    std::string PreprocessText(const std::string& text) const;
+private:
+    // Annotated document without embeddings and the tokens of the title and the text to calculate them
+    struct TPreparedDocument {
+        TDbDocument Doc;
+        TTokenStream Tokens;
+        // Filled by the embedders, so the words are looked up once per vector model
+        TWordVectorCache WordVectors;
+        bool NeedsEmbeddings = false;
+    };
+
+    // Consecutive input records: JSON objects, html paths or names of archived htmls.
+    // Html files are opened and read by the workers, so the file syscalls of different chunks run in parallel.
+    struct TRecordsChunk {
+        size_t Index = 0;
+        std::vector<std::string> Records;
+        std::vector<std::string_view> ArchivedHtmls;
+    };
+
+    std::optional<TDbDocument> AnnotateDocument(const TDocument& document) const;
+    std::optional<TPreparedDocument> PrepareDocument(const TDocument& document) const;
+    std::optional<TPreparedDocument> PrepareHtml(std::string_view html, const std::string& path) const;
+    void CalcEmbeddings(const std::vector<TPreparedDocument*>& batch) const;
+    std::vector<TDbDocument> AnnotateRecords(const TRecordsChunk& chunk, tg::EInputFormat inputFormat) const;
+
+    void PreprocessText(const std::string& text, TTokenStream* tokens) const;
 
 private:
     tg::TAnnotatorConfig Config;
@@ -55,5 +91,6 @@ private:
     bool SaveNotNews = false;
     bool SaveTexts = false;
     bool ComputeNasty = false;
+    size_t EmbeddingBatchSize = 128;
     std::string Mode;
 };
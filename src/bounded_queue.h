@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Multi-producer multi-consumer queue, producers are blocked while it is full
+template<class T>
+class TBoundedQueue {
+public:
+    explicit TBoundedQueue(size_t capacity)
+        : Capacity(capacity != 0 ? capacity : 1)
+    {}
+
+    // Returns false if the queue is closed
+    bool Push(T&& item) {
+        std::unique_lock<std::mutex> lock(Mutex);
+        NotFull.wait(lock, [this] { return IsClosed || Items.size() < Capacity; });
+        if (IsClosed) {
+            return false;
+        }
+        Items.push_back(std::move(item));
+        NotEmpty.notify_one();
+        return true;
+    }
+
+    // Returns std::nullopt if the queue is closed and empty
+    std::optional<T> Pop() {
+        std::unique_lock<std::mutex> lock(Mutex);
+        NotEmpty.wait(lock, [this] { return IsClosed || !Items.empty(); });
+        if (Items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(Items.front());
+        Items.pop_front();
+        NotFull.notify_one();
+        return item;
+    }
+
+    // Queued items are still popped after closing
+    void Close() {
+        std::lock_guard<std::mutex> lock(Mutex);
+        IsClosed = true;
+        NotFull.notify_all();
+        NotEmpty.notify_all();
+    }
+
+private:
+    const size_t Capacity;
+    std::deque<T> Items;
+    std::mutex Mutex;
+    std::condition_variable NotFull;
+    std::condition_variable NotEmpty;
+    bool IsClosed = false;
+};
@@ -8,19 +8,20 @@
 
 #include <cassert>
 #include <cmath>
-#include <set>
+#include <iterator>
+#include <unordered_map>
 #include <vector>
 
-void TNewsCluster::AddDocument(const TDbDocument& document) {
-    Documents.push_back(std::move(document));
-    FreshestTimestamp = std::max(FreshestTimestamp, static_cast<uint64_t>(Documents.back().FetchTime));
+void TNewsCluster::AddDocument(uint32_t docIndex) {
+    DocIndices.push_back(docIndex);
+    FreshestTimestamp = std::max(FreshestTimestamp, static_cast<uint64_t>((*Arena)[docIndex].FetchTime));
 }
 
 uint64_t TNewsCluster::GetTimestamp(float percentile) const {
-    assert(!Documents.empty());
+    assert(!DocIndices.empty());
     std::vector<uint64_t> clusterTimestamps;
-    clusterTimestamps.reserve(Documents.size());
-    for (const TDbDocument& doc : Documents) {
+    clusterTimestamps.reserve(DocIndices.size());
+    for (const TDbDocument& doc : GetDocuments()) {
         clusterTimestamps.push_back(doc.FetchTime);
     }
     size_t index = static_cast<size_t>(std::floor(percentile * (clusterTimestamps.size() - 1)));
@@ -31,12 +32,11 @@ uint64_t TNewsCluster::GetTimestamp(float percentile) const {
 void TNewsCluster::Summarize(const TAgencyRating& agencyRating) {
     assert(GetSize() != 0);
     const auto embeddingKey = (GetLanguage() == tg::LN_RU ? tg::EK_FASTTEXT_TITLE : tg::EK_FASTTEXT_CLASSIC);
-    const size_t embeddingSize = Documents.back().Embeddings.at(embeddingKey).size();
-    Eigen::MatrixXf points(GetSize(), embeddingSize);
+    const TEmbeddingMatrix& embeddings = Arena->GetEmbeddings(embeddingKey);
+    const auto arenaPoints = embeddings.GetMatrix();
+    Eigen::MatrixXf points(GetSize(), embeddings.GetCols());
     for (size_t i = 0; i < GetSize(); i++) {
-        auto embedding = Documents[i].Embeddings.at(embeddingKey);
-        Eigen::Map<Eigen::VectorXf, Eigen::Unaligned> eigenVector(embedding.data(), embedding.size());
-        points.row(i) = eigenVector / eigenVector.norm();
+        points.row(i) = arenaPoints.row(DocIndices[i]);
     }
     Eigen::MatrixXf docsCosine = points * points.transpose();
 
@@ -44,11 +44,11 @@ void TNewsCluster::Summarize(const TAgencyRating& agencyRating) {
     weights.reserve(GetSize());
     uint64_t freshestTimestamp = GetFreshestTimestamp();
     for (size_t i = 0; i < GetSize(); ++i) {
-        const TDbDocument& doc = Documents[i];
+        const TDbDocument& doc = GetDocument(i);
         double docRelevance = docsCosine.row(i).mean();
         int64_t timeDiff = static_cast<int64_t>(doc.FetchTime) - static_cast<int64_t>(freshestTimestamp);
         double timeMultiplier = Sigmoid(static_cast<double>(timeDiff) / 3600.0 + 12.0);
-        double agencyScore = agencyRating.ScoreUrl(doc.Url);
+        double agencyScore = agencyRating.ScoreHost(Arena->GetHostId(DocIndices[i]));
         double weight = (agencyScore + docRelevance) * timeMultiplier;
         if (doc.Nasty) {
             weight *= 0.5;
@@ -58,127 +58,202 @@ void TNewsCluster::Summarize(const TAgencyRating& agencyRating) {
     SortByWeights(weights);
 }
 
-void TNewsCluster::CalcFeatures(
-    const TAlexaAgencyRating& alexaRating,
-    const std::vector<TDbDocument>& docs)
-{
-    Features.reserve(3*4*6 + 2*4*6);
-    const char* codes[] = {"US", "GB", "IN", "RU", "CA", "AU"};
-    const double decays[] = {1800., 3600., 7200., 86400.};
-    const double shifts[] = {1., 1.3, 1.6};
-    for (double shift : shifts) {
-        for (double decay : decays) {
-            auto slice = CalcImportance(alexaRating, docs, tg::LN_EN, RT_LOG, shift, decay);
-            Features.push_back(slice.Importance);
-            if (decay != 86400.) {
-                continue;
+namespace {
+    const double FEATURE_DECAYS[] = {1800., 3600., 7200., 86400.};
+    const double FEATURE_SHIFTS[] = {1., 1.3, 1.6};
+    constexpr double SHARES_DECAY = 86400.;
+
+    // Importance of the cluster is the slice with shift 1 and decay 3600, it is also used as a feature
+    constexpr size_t MAIN_SLICE_INDEX = 1;
+
+    std::vector<TSliceParams> MakeFeatureSlicesParams() {
+        std::vector<TSliceParams> slicesParams;
+        for (double shift : FEATURE_SHIFTS) {
+            for (double decay : FEATURE_DECAYS) {
+                slicesParams.push_back(TSliceParams{RT_LOG, shift, decay});
             }
-            for (const std::string& code : codes) {
-                Features.push_back(slice.WeightedCountryShare[code]);
+        }
+        for (ERatingType type : {RT_RAW, RT_ONE}) {
+            for (double decay : FEATURE_DECAYS) {
+                slicesParams.push_back(TSliceParams{type, 0.0, decay});
             }
         }
+        return slicesParams;
     }
-    for (ERatingType type : {RT_RAW, RT_ONE}) {
-        for (double decay : decays) {
-            auto slice = CalcImportance(alexaRating, docs, tg::LN_EN, type, 0.0, decay);
-            Features.push_back(slice.Importance);
-            if (decay != 86400.) {
-                continue;
-            }
-            for (const std::string& code : codes) {
-                Features.push_back(slice.WeightedCountryShare[code]);
-            }
+}
+
+void TNewsCluster::CalcFeatures(
+    const std::vector<TSliceParams>& slicesParams,
+    const std::vector<TSliceFeatures>& slices)
+{
+    assert(slicesParams.size() == slices.size());
+    Features.clear();
+    Features.reserve(3*4*6 + 2*4*6);
+    for (size_t i = 0; i < slices.size(); ++i) {
+        Features.push_back(slices[i].Importance);
+        if (slicesParams[i].Decay != SHARES_DECAY) {
+            continue;
+        }
+        for (size_t country = 0; country < CN_COUNT; ++country) {
+            Features.push_back(slices[i].WeightedCountryShare.at(ToCountryCode(static_cast<ECountry>(country))));
         }
     }
 }
 
-TSliceFeatures TNewsCluster::CalcImportance(
+std::vector<TSliceFeatures> TNewsCluster::CalcImportance(
     const TAlexaAgencyRating& alexaRating,
-    const std::vector<TDbDocument>& docs,
+    const std::vector<uint32_t>& sortedDocIndices,
     tg::ELanguage language,
-    ERatingType type,
-    double shift,
-    double decay)
+    const std::vector<TSliceParams>& slicesParams) const
 {
-    double count = 0;
-    double wCount = 0;
-    TSliceFeatures slice;
-
-    const char* codes[] = {"US", "GB", "IN", "RU", "CA", "AU"};
-    for (const std::string& code : codes) {
-        slice.CountryShare[code] = 0;
-        slice.WeightedCountryShare[code] = 0;
-    }
-
-    slice.DocWeights.reserve(GetSize());
-    for (const TDbDocument& doc : Documents) {
-        double agencyWeight = alexaRating.ScoreUrl(doc.Host, language, type, shift);
-        slice.DocWeights.push_back(agencyWeight);
-
-        const std::string& docHost = doc.Host;;
-        for (const std::string& code : codes) {
-            double share = alexaRating.GetCountryShare(docHost, code);
-            slice.CountryShare[code] += share;
-            slice.WeightedCountryShare[code] += share * agencyWeight;
+    const size_t slicesCount = slicesParams.size();
+
+    // Global host ids of the arena are remapped to the dense ids of the cluster hosts
+    std::unordered_map<uint32_t, uint32_t> hostIds;
+    std::vector<uint32_t> hosts;
+    const auto getHostId = [&](uint32_t docIndex) {
+        const uint32_t globalHostId = Arena->GetHostId(docIndex);
+        const auto [it, inserted] = hostIds.try_emplace(globalHostId, static_cast<uint32_t>(hosts.size()));
+        if (inserted) {
+            hosts.push_back(globalHostId);
+        }
+        return it->second;
+    };
+    std::vector<uint32_t> docHostIds;
+    docHostIds.reserve(GetSize());
+    for (uint32_t docIndex : DocIndices) {
+        docHostIds.push_back(getHostId(docIndex));
+    }
+    std::vector<uint32_t> sortedHostIds;
+    std::vector<int32_t> sortedTimestamps;
+    sortedHostIds.reserve(sortedDocIndices.size());
+    sortedTimestamps.reserve(sortedDocIndices.size());
+    for (uint32_t docIndex : sortedDocIndices) {
+        sortedHostIds.push_back(getHostId(docIndex));
+        sortedTimestamps.push_back(static_cast<int32_t>((*Arena)[docIndex].FetchTime));
+    }
+    const size_t hostsCount = hosts.size();
+
+    std::vector<double> hostShares(hostsCount * CN_COUNT);
+    for (size_t hostId = 0; hostId < hostsCount; ++hostId) {
+        for (size_t country = 0; country < CN_COUNT; ++country) {
+            hostShares[hostId * CN_COUNT + country] = alexaRating.GetCountryShare(hosts[hostId], static_cast<ECountry>(country));
+        }
+    }
+    std::vector<double> hostWeights(slicesCount * hostsCount);
+    for (size_t sliceIndex = 0; sliceIndex < slicesCount; ++sliceIndex) {
+        const TSliceParams& params = slicesParams[sliceIndex];
+        for (size_t hostId = 0; hostId < hostsCount; ++hostId) {
+            hostWeights[sliceIndex * hostsCount + hostId] = alexaRating.ScoreHost(hosts[hostId], language, params.Type, params.Shift);
         }
-        count += 1;
-        wCount += agencyWeight;
     }
 
-    for (const std::string& code : codes) {
-        if (count > 0) {
-            slice.CountryShare[code] /= count;
+    std::vector<TSliceFeatures> slices(slicesCount);
+    for (size_t sliceIndex = 0; sliceIndex < slicesCount; ++sliceIndex) {
+        TSliceFeatures& slice = slices[sliceIndex];
+        const double* weights = hostWeights.data() + sliceIndex * hostsCount;
+
+        double count = 0;
+        double wCount = 0;
+        double countryShare[CN_COUNT] = {};
+        double weightedCountryShare[CN_COUNT] = {};
+        slice.DocWeights.reserve(GetSize());
+        for (uint32_t hostId : docHostIds) {
+            double agencyWeight = weights[hostId];
+            slice.DocWeights.push_back(agencyWeight);
+            for (size_t country = 0; country < CN_COUNT; ++country) {
+                double share = hostShares[hostId * CN_COUNT + country];
+                countryShare[country] += share;
+                weightedCountryShare[country] += share * agencyWeight;
+            }
+            count += 1;
+            wCount += agencyWeight;
         }
-        if (wCount > 0) {
-            slice.WeightedCountryShare[code] /= wCount;
+        for (size_t country = 0; country < CN_COUNT; ++country) {
+            if (count > 0) {
+                countryShare[country] /= count;
+            }
+            if (wCount > 0) {
+                weightedCountryShare[country] /= wCount;
+            }
+            const char* code = ToCountryCode(static_cast<ECountry>(country));
+            slice.CountryShare[code] = countryShare[country];
+            slice.WeightedCountryShare[code] = weightedCountryShare[country];
         }
     }
 
-    for (size_t i = 0; i < docs.size(); ++i) {
-        const TDbDocument& startDoc = docs[i];
-        int32_t startTime = startDoc.FetchTime;
-        double rank = 0.;
-
-        std::set<std::string> seenHosts;
-        for (size_t j = i; j < docs.size(); ++j) {
-            const TDbDocument& doc = docs[j];
-            const std::string& docHost = doc.Host;
-            if (seenHosts.insert(docHost).second) {
-                double agencyWeight = alexaRating.ScoreUrl(docHost, language, type, shift);
-                double docTimestampRemapped = static_cast<double>(startTime - static_cast<int32_t>(doc.FetchTime)) / decay;
-                double timeMultiplier = Sigmoid(std::max(docTimestampRemapped, -15.));
-                double score = agencyWeight * timeMultiplier;
-                rank += score;
+    // Slices share decays, so time multipliers are calculated once per decay
+    std::vector<double> decays;
+    std::vector<size_t> sliceDecayIndices;
+    sliceDecayIndices.reserve(slicesCount);
+    for (const TSliceParams& params : slicesParams) {
+        const auto it = std::find(decays.begin(), decays.end(), params.Decay);
+        sliceDecayIndices.push_back(std::distance(decays.begin(), it));
+        if (it == decays.end()) {
+            decays.push_back(params.Decay);
+        }
+    }
+    std::vector<double> timeMultipliers(decays.size());
+
+    // Documents are summed in the same order as in the naive per-slice loops, so ranks are bit-exact
+    std::vector<double> ranks(slicesCount);
+    std::vector<size_t> hostSeenAt(hostsCount, sortedDocIndices.size());
+    for (size_t i = 0; i < sortedDocIndices.size(); ++i) {
+        int32_t startTime = sortedTimestamps[i];
+        std::fill(ranks.begin(), ranks.end(), 0.);
+
+        for (size_t j = i; j < sortedDocIndices.size(); ++j) {
+            const uint32_t hostId = sortedHostIds[j];
+            if (hostSeenAt[hostId] == i) {
+                continue;
+            }
+            hostSeenAt[hostId] = i;
+            for (size_t decayIndex = 0; decayIndex < decays.size(); ++decayIndex) {
+                double docTimestampRemapped = static_cast<double>(startTime - sortedTimestamps[j]) / decays[decayIndex];
+                timeMultipliers[decayIndex] = Sigmoid(std::max(docTimestampRemapped, -15.));
+            }
+            for (size_t sliceIndex = 0; sliceIndex < slicesCount; ++sliceIndex) {
+                double score = hostWeights[sliceIndex * hostsCount + hostId] * timeMultipliers[sliceDecayIndices[sliceIndex]];
+                ranks[sliceIndex] += score;
             }
         }
-        if (rank > slice.Importance) {
-            slice.Importance = rank;
-            slice.BestTimestamp = startDoc.FetchTime;
+        for (size_t sliceIndex = 0; sliceIndex < slicesCount; ++sliceIndex) {
+            if (ranks[sliceIndex] > slices[sliceIndex].Importance) {
+                slices[sliceIndex].Importance = ranks[sliceIndex];
+                slices[sliceIndex].BestTimestamp = (*Arena)[sortedDocIndices[i]].FetchTime;
+            }
         }
     }
-    return slice;
+    return slices;
 }
 
 void TNewsCluster::CalcImportance(const TAlexaAgencyRating& alexaRating) {
-    auto docs = GetDocuments();
-    std::stable_sort(docs.begin(), docs.end(), [](const TDbDocument& p1, const TDbDocument& p2) {
+    std::vector<uint32_t> sortedDocIndices = DocIndices;
+    std::stable_sort(sortedDocIndices.begin(), sortedDocIndices.end(), [this](uint32_t i1, uint32_t i2) {
+        const TDbDocument& p1 = (*Arena)[i1];
+        const TDbDocument& p2 = (*Arena)[i2];
         if (p1.FetchTime != p2.FetchTime) {
             return p1.FetchTime < p2.FetchTime;
         }
         return p1.Url < p2.Url;
     });
-    CalcFeatures(alexaRating, docs);
-    TSliceFeatures slice = CalcImportance(alexaRating, docs, tg::LN_EN, RT_LOG, 1., 3600);
+    const std::vector<TSliceParams> slicesParams = MakeFeatureSlicesParams();
+    std::vector<TSliceFeatures> slices = CalcImportance(alexaRating, sortedDocIndices, tg::LN_EN, slicesParams);
+    CalcFeatures(slicesParams, slices);
+
+    assert(slicesParams[MAIN_SLICE_INDEX].Type == RT_LOG);
+    assert(slicesParams[MAIN_SLICE_INDEX].Shift == 1. && slicesParams[MAIN_SLICE_INDEX].Decay == 3600.);
+    TSliceFeatures& slice = slices[MAIN_SLICE_INDEX];
     BestTimestamp = slice.BestTimestamp;
     Importance = slice.Importance;
-    DocWeights = slice.DocWeights;
-    CountryShare = slice.CountryShare;
-    WeightedCountryShare = slice.WeightedCountryShare;
+    DocWeights = std::move(slice.DocWeights);
+    CountryShare = std::move(slice.CountryShare);
+    WeightedCountryShare = std::move(slice.WeightedCountryShare);
 }
 
 void TNewsCluster::CalcCategory() {
     std::vector<size_t> categoryCount(tg::ECategory_ARRAYSIZE);
-    for (const TDbDocument& doc : Documents) {
+    for (const TDbDocument& doc : GetDocuments()) {
         tg::ECategory docCategory = doc.Category;
         assert(doc.IsNews());
         categoryCount[static_cast<size_t>(docCategory)] += 1;
@@ -188,23 +263,22 @@ void TNewsCluster::CalcCategory() {
 }
 
 void TNewsCluster::SortByWeights(const std::vector<double>& weights) {
-    std::vector<std::pair<TDbDocument, double>> weightedDocs;
-    weightedDocs.reserve(Documents.size());
-    for (size_t i = 0; i < Documents.size(); i++) {
-        weightedDocs.emplace_back(std::move(Documents[i]), weights[i]);
-    }
-    Documents.clear();
-    std::stable_sort(weightedDocs.begin(), weightedDocs.end(), [](
-        const std::pair<TDbDocument, double>& a,
-        const std::pair<TDbDocument, double>& b)
+    std::vector<std::pair<uint32_t, double>> weightedDocs;
+    weightedDocs.reserve(DocIndices.size());
+    for (size_t i = 0; i < DocIndices.size(); i++) {
+        weightedDocs.emplace_back(DocIndices[i], weights[i]);
+    }
+    std::stable_sort(weightedDocs.begin(), weightedDocs.end(), [this](
+        const std::pair<uint32_t, double>& a,
+        const std::pair<uint32_t, double>& b)
     {
         if (std::abs(a.second - b.second) < 0.000001) {
-            return a.first.Title < b.first.Title;
+            return (*Arena)[a.first].Title < (*Arena)[b.first].Title;
         }
         return a.second > b.second;
     });
-    for (const auto& [doc, _] : weightedDocs) {
-        AddDocument(doc);
+    for (size_t i = 0; i < weightedDocs.size(); i++) {
+        DocIndices[i] = weightedDocs[i].first;
     }
 }
 
@@ -1,11 +1,20 @@
 #pragma once
 
 #include "db_document.h"
+#include "document_arena.h"
 #include "agency_rating.h"
 
+#include <boost/range/adaptor/transformed.hpp>
+
 class TAgencyRating;
 class TAlexaAgencyRating;
 
+struct TSliceParams {
+    ERatingType Type = RT_LOG;
+    double Shift = 0.0;
+    double Decay = 3600.0;
+};
+
 struct TSliceFeatures {
     uint64_t BestTimestamp = 0;
     double Importance = 0.0;
@@ -28,25 +37,25 @@ private:
     std::map<std::string, double> CountryShare;
     std::map<std::string, double> WeightedCountryShare;
 
-    std::vector<TDbDocument> Documents;
+    TDocumentArenaPtr Arena;
+    std::vector<uint32_t> DocIndices;
 
 public:
-    explicit TNewsCluster(uint64_t id) : Id(id) {};
+    TNewsCluster(uint64_t id, TDocumentArenaPtr arena) : Id(id), Arena(std::move(arena)) {};
 
-    void AddDocument(const TDbDocument& document);
+    void AddDocument(uint32_t docIndex);
     void Summarize(const TAgencyRating& agencyRating);
 
     void CalcFeatures(
-        const TAlexaAgencyRating& alexaRating,
-        const std::vector<TDbDocument>& docs);
+        const std::vector<TSliceParams>& slicesParams,
+        const std::vector<TSliceFeatures>& slices);
 
-    TSliceFeatures CalcImportance(
+    // All slices are calculated in one pass over the documents sorted by time
+    std::vector<TSliceFeatures> CalcImportance(
         const TAlexaAgencyRating& alexaRating,
-        const std::vector<TDbDocument>& docs,
+        const std::vector<uint32_t>& sortedDocIndices,
         tg::ELanguage language,
-        ERatingType type,
-        double shift,
-        double decay);
+        const std::vector<TSliceParams>& slicesParams) const;
 
     void CalcImportance(const TAlexaAgencyRating& alexaRating);
     void CalcCategory();
@@ -58,10 +67,16 @@ public:
 
     tg::ECategory GetCategory() const { return Category; }
     uint64_t GetFreshestTimestamp() const { return FreshestTimestamp; }
-    size_t GetSize() const { return Documents.size(); }
-    const std::vector<TDbDocument>& GetDocuments() const { return Documents; }
-    std::string GetTitle() const { return Documents.front().Title; }
-    tg::ELanguage GetLanguage() const { return Documents.front().Language; }
+    size_t GetSize() const { return DocIndices.size(); }
+    const TDbDocument& GetDocument(size_t i) const { return (*Arena)[DocIndices[i]]; }
+    const std::vector<uint32_t>& GetDocIndices() const { return DocIndices; }
+    auto GetDocuments() const {
+        return DocIndices | boost::adaptors::transformed([this](uint32_t docIndex) -> const TDbDocument& {
+            return (*Arena)[docIndex];
+        });
+    }
+    std::string GetTitle() const { return GetDocument(0).Title; }
+    tg::ELanguage GetLanguage() const { return GetDocument(0).Language; }
     double GetImportance() const { return Importance; }
     uint64_t GetBestTimestamp() const { return BestTimestamp; }
     const std::vector<double>& GetDocWeights() const { return DocWeights; }
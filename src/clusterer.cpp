@@ -1,34 +1,61 @@
 #include "clusterer.h"
 #include "clustering/slink.h"
+#include "timer.h"
 #include "util.h"
 
 #include <iostream>
 
 
-uint64_t GetIterTimestamp(const std::vector<TDbDocument>& documents, double percentile) {
+namespace {
+
+const TDbDocument& GetDocument(const TDbDocument& doc) {
+    return doc;
+}
+
+const TDbDocument& GetDocument(const TDbDocumentPtr& doc) {
+    return *doc;
+}
+
+template <typename TDocument>
+uint64_t GetIterTimestamp(const std::vector<TDocument>& documents, double percentile) {
     // In production ts.now() should be here.
     // In this case we have percentile of documents timestamps because of the small percent of wrong dates.
     if (documents.empty()) {
         return 0;
     }
-    assert(std::is_sorted(documents.begin(), documents.end(), [](const TDbDocument& d1, const TDbDocument& d2) {
-        return d1.FetchTime < d2.FetchTime;
+    assert(std::is_sorted(documents.begin(), documents.end(), [](const TDocument& d1, const TDocument& d2) {
+        return GetDocument(d1).FetchTime < GetDocument(d2).FetchTime;
     }));
 
     size_t index = std::floor(percentile * documents.size());
-    return documents[index].FetchTime;
+    return GetDocument(documents[index]).FetchTime;
 }
 
-TClusterer::TClusterer(const std::string& configPath) {
+} // namespace
+
+TClusterer::TClusterer(const std::string& configPath)
+    : ThreadPool(std::make_unique<TWorkStealingPool>())
+{
     ::ParseConfig(configPath, Config);
     for (const tg::TClusteringConfig& config: Config.clusterings()) {
-        Clusterings[config.language()] = std::make_unique<TSlinkClustering>(config);
+        Clusterings[config.language()] = std::make_unique<TSlinkClustering>(config, ThreadPool.get());
     }
 }
 
-TClusterIndex TClusterer::Cluster(std::vector<TDbDocument>&& docs) const {
+TClusterIndex TClusterer::Cluster(std::vector<TDbDocumentPtr>&& docs, TClustererState* state) const {
+    return ClusterDocuments(std::move(docs), state);
+}
+
+TClusterIndex TClusterer::Cluster(std::vector<TDbDocument>&& docs, TClustererState* state) const {
+    return ClusterDocuments(std::move(docs), state);
+}
+
+template <typename TDocument>
+TClusterIndex TClusterer::ClusterDocuments(std::vector<TDocument>&& docs, TClustererState* state) const {
     std::stable_sort(docs.begin(), docs.end(),
-        [](const TDbDocument& d1, const TDbDocument& d2) {
+        [](const TDocument& doc1, const TDocument& doc2) {
+            const TDbDocument& d1 = GetDocument(doc1);
+            const TDbDocument& d2 = GetDocument(doc2);
             if (d1.FetchTime == d2.FetchTime) {
                 if (d1.FileName.empty() && d2.FileName.empty()) {
                     return d1.Title.length() < d2.Title.length();
@@ -40,21 +67,44 @@ TClusterIndex TClusterer::Cluster(std::vector<TDbDocument>&& docs) const {
     );
     TClusterIndex clusterIndex;
     clusterIndex.IterTimestamp = GetIterTimestamp(docs, Config.iter_timestamp_percentile());
-    clusterIndex.TrueMaxTimestamp = docs.empty() ? 0 : docs.back().FetchTime;
+    clusterIndex.TrueMaxTimestamp = docs.empty() ? 0 : GetDocument(docs.back()).FetchTime;
 
-    std::map<tg::ELanguage, std::vector<TDbDocument>> lang2Docs;
+    std::map<tg::ELanguage, std::vector<TDocument>> lang2Docs;
     while (!docs.empty()) {
-        const TDbDocument& doc = docs.back();
-        if (Clusterings.find(doc.Language) != Clusterings.end()) {
-            lang2Docs[doc.Language].push_back(doc);
+        TDocument& doc = docs.back();
+        const tg::ELanguage language = GetDocument(doc).Language;
+        if (Clusterings.find(language) != Clusterings.end()) {
+            lang2Docs[language].push_back(std::move(doc));
         }
         docs.pop_back();
     }
     docs.shrink_to_fit();
     docs.clear();
 
+    // Documents are owned by the per-language arenas, clusters only keep indices
+    std::map<tg::ELanguage, TDocumentArenaPtr> lang2Arena;
     for (const auto& [language, clustering] : Clusterings) {
-        TClusters langClusters = clustering->Cluster(lang2Docs[language]);
+        lang2Arena[language] = std::make_shared<const TDocumentArena>(std::move(lang2Docs[language]));
+    }
+    lang2Docs.clear();
+
+    // Languages share no state, so they are clustered concurrently
+    std::vector<tg::ELanguage> languages;
+    std::vector<TClusteringState*> langStates;
+    for (const auto& [language, clustering] : Clusterings) {
+        languages.push_back(language);
+        langStates.push_back(state ? &(*state)[language] : nullptr);
+    }
+    std::vector<TClusters> langsClusters(languages.size());
+    ThreadPool->ParallelFor(0, languages.size(), [&](size_t i) {
+        const tg::ELanguage language = languages[i];
+        const auto& clustering = Clusterings.at(language);
+        const TDocumentArenaPtr& langDocs = lang2Arena.at(language);
+        TClusteringState* langState = langStates[i];
+        TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> timer;
+        TClusters langClusters = langState
+            ? clustering->Cluster(langDocs, *langState)
+            : clustering->Cluster(langDocs);
         std::stable_sort(
             langClusters.begin(),
             langClusters.end(),
@@ -62,7 +112,11 @@ TClusterIndex TClusterer::Cluster(std::vector<TDbDocument>&& docs) const {
                 return a.GetFreshestTimestamp() < b.GetFreshestTimestamp();
             }
         );
-        clusterIndex.Clusters[language] = std::move(langClusters);
+        LOG_DEBUG("Clustering " << ToString(language) << ": " << timer.Elapsed() << " ms");
+        langsClusters[i] = std::move(langClusters);
+    });
+    for (size_t i = 0; i < languages.size(); ++i) {
+        clusterIndex.Clusters[languages[i]] = std::move(langsClusters[i]);
     }
     return clusterIndex;
 }
@@ -5,27 +5,52 @@
 #include "clustering/clustering.h"
 #include "config.pb.h"
 #include "db_document.h"
+#include "ranker.h"
+#include "work_stealing_pool.h"
 
 #include <vector>
 #include <memory>
 
 struct TClusterIndex {
+    TClusterIndex() = default;
+    // Tops refer to the clusters, a copy would refer to the clusters of the original.
+    // A move keeps the cluster vectors, so the references stay valid.
+    TClusterIndex(const TClusterIndex&) = delete;
+    TClusterIndex& operator=(const TClusterIndex&) = delete;
+    TClusterIndex(TClusterIndex&&) = default;
+    TClusterIndex& operator=(TClusterIndex&&) = default;
+
     std::unordered_map<tg::ELanguage, TClusters> Clusters;
     uint64_t IterTimestamp = 0;
     uint64_t TrueMaxTimestamp = 0;
+
+    // Incremented on every clustering iteration of the server
+    uint64_t Generation = 0;
+
+    // Tops for the period buckets of the ranker, they refer to the clusters above
+    std::unordered_map<tg::ELanguage, std::map<uint64_t, TRankedTops>> Tops;
 };
 
+using TClustererState = std::unordered_map<tg::ELanguage, TClusteringState>;
+
 class TClusterer {
 public:
     TClusterer(const std::string& configPath);
 
-    TClusterIndex Cluster(std::vector<TDbDocument>&& docs) const;
+    // Shared documents are not changed, owned documents are moved into the clusters
+    TClusterIndex Cluster(std::vector<TDbDocumentPtr>&& docs, TClustererState* state = nullptr) const;
+    TClusterIndex Cluster(std::vector<TDbDocument>&& docs, TClustererState* state = nullptr) const;
 
 private:
+    template <typename TDocument>
+    TClusterIndex ClusterDocuments(std::vector<TDocument>&& docs, TClustererState* state) const;
+
     void Summarize(TClusters& clusters) const;
     void CalcWeights(TClusters& clusters) const;
 
 private:
     tg::TClustererConfig Config;
+    // Shared by the languages and the chunks of the clusterings, created once for all iterations
+    std::unique_ptr<TWorkStealingPool> ThreadPool;
     std::unordered_map<tg::ELanguage, std::unique_ptr<TClustering>> Clusterings;
 };
@@ -2,12 +2,26 @@
 
 #include "../cluster.h"
 #include "../db_document.h"
+#include "../document_arena.h"
+
+#include <string>
+#include <unordered_map>
+
+// Labels assigned to documents on the previous clustering iteration
+struct TClusteringState {
+    std::unordered_map<std::string, size_t> Labels;
+    size_t MaxLabel = 0;
+};
 
 class TClustering {
 public:
     TClustering() = default;
     virtual ~TClustering() = default;
     virtual TClusters Cluster(
-        const std::vector<TDbDocument>& docs
+        const TDocumentArenaPtr& docs
+    ) = 0;
+    virtual TClusters Cluster(
+        const TDocumentArenaPtr& docs,
+        TClusteringState& state
     ) = 0;
 };
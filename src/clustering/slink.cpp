@@ -14,25 +14,34 @@ namespace {
 using TClusterSiteNames = std::unordered_set<std::string>;
 
 constexpr float INF_DISTANCE = 1.0f;
+constexpr size_t KNN_BLOCK_SIZE = 512;
+
+struct TDistanceEdge {
+    float Distance = INF_DISTANCE;
+    uint32_t From = 0;
+    uint32_t To = 0;
+};
+
+float CalcTimePenalty(uint64_t leftTs, uint64_t rightTs) {
+    uint64_t diff = rightTs > leftTs ? rightTs - leftTs : leftTs - rightTs;
+    float diffHours = static_cast<float>(diff) / 3600.0f;
+    float penalty = 1.0f;
+    if (diffHours >= 24.0f) {
+        penalty = diffHours / 24.0f;
+    }
+    return penalty;
+}
 
 void ApplyTimePenalty(
-    const std::vector<TDbDocument>::const_iterator begin,
+    const TDocumentArena& docs,
+    size_t batchBegin,
     size_t docSize,
     Eigen::MatrixXf& distances
 ) {
-    std::vector<TDbDocument>::const_iterator iIt = begin;
-    std::vector<TDbDocument>::const_iterator jIt = begin + 1;
-    for (size_t i = 0; i < docSize; ++i, ++iIt) {
-        jIt = iIt + 1;
-        for (size_t j = i + 1; j < docSize; ++j, ++jIt) {
-            uint64_t leftTs = iIt->FetchTime;
-            uint64_t rightTs = jIt->FetchTime;
-            uint64_t diff = rightTs > leftTs ? rightTs - leftTs : leftTs - rightTs;
-            float diffHours = static_cast<float>(diff) / 3600.0f;
-            float penalty = 1.0f;
-            if (diffHours >= 24.0f) {
-                penalty = diffHours / 24.0f;
-            }
+    for (size_t i = 0; i < docSize; ++i) {
+        const uint64_t iFetchTime = docs[batchBegin + i].FetchTime;
+        for (size_t j = i + 1; j < docSize; ++j) {
+            float penalty = CalcTimePenalty(iFetchTime, docs[batchBegin + j].FetchTime);
             distances(i, j) = std::min(penalty * distances(i, j), INF_DISTANCE);
             distances(j, i) = distances(i, j);
         }
@@ -63,47 +72,119 @@ bool HasSameSource(const TClusterSiteNames& firstSet, const TClusterSiteNames& s
     return CheckSetIntersection(secondSet, firstSet);
 }
 
+size_t FindRoot(std::vector<size_t>& parents, size_t i) {
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+std::unordered_map<tg::EEmbeddingKey, float> GetEmbeddingKeysWeights(const tg::TClusteringConfig& config) {
+    std::unordered_map<tg::EEmbeddingKey, float> embeddingKeysWeights;
+    for (const auto& embeddingKeyWeight : config.embedding_keys_weights()) {
+        embeddingKeysWeights[embeddingKeyWeight.embedding_key()] = embeddingKeyWeight.weight();
+    }
+    return embeddingKeysWeights;
+}
+
+TClusters MakeClusters(const TDocumentArenaPtr& docs, const std::vector<size_t>& labels) {
+    std::unordered_map<size_t, size_t> clusterLabels;
+    TClusters clusters;
+    for (uint32_t i = 0; i < docs->Size(); ++i) {
+        const size_t clusterId = labels[i];
+        auto it = clusterLabels.find(clusterId);
+        if (it == clusterLabels.end()) {
+            size_t newLabel = clusters.size();
+            clusterLabels[clusterId] = newLabel;
+            clusters.emplace_back(newLabel, docs);
+            clusters[newLabel].AddDocument(i);
+        } else {
+            clusters[it->second].AddDocument(i);
+        }
+    }
+    return clusters;
+}
+
 } // namespace
 
-TSlinkClustering::TSlinkClustering(const tg::TClusteringConfig& config)
+TSlinkClustering::TSlinkClustering(const tg::TClusteringConfig& config, TWorkStealingPool* threadPool)
     : Config(config)
+    , ThreadPool(threadPool)
 {
 }
 
 TClusters TSlinkClustering::Cluster(
-    const std::vector<TDbDocument>& docs
+    const TDocumentArenaPtr& docs
 ) {
-    std::unordered_map<tg::EEmbeddingKey, float> embeddingKeysWeights;
-    for (const auto& embeddingKeyWeight : Config.embedding_keys_weights()) {
-        embeddingKeysWeights[embeddingKeyWeight.embedding_key()] = embeddingKeyWeight.weight();
+    const std::vector<size_t> labels = CalcLabels(*docs, GetEmbeddingKeysWeights(Config));
+    return MakeClusters(docs, labels);
+}
+
+TClusters TSlinkClustering::Cluster(
+    const TDocumentArenaPtr& docs,
+    TClusteringState& state
+) {
+    const std::vector<size_t> labels = CalcLabels(*docs, state, GetEmbeddingKeysWeights(Config));
+
+    state.Labels.clear();
+    state.MaxLabel = 0;
+    for (size_t i = 0; i < docs->Size(); ++i) {
+        state.Labels[(*docs)[i].FileName] = labels[i];
+        state.MaxLabel = std::max(state.MaxLabel, labels[i]);
     }
-    const size_t docSize = docs.size();
+    return MakeClusters(docs, labels);
+}
+
+std::vector<size_t> TSlinkClustering::CalcLabels(
+    const TDocumentArena& docs,
+    const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
+) const {
+    const size_t docSize = docs.Size();
     const size_t intersectionSize = Config.intersection_size();
-    std::vector<size_t> labels;
-    labels.reserve(docSize);
 
-    std::vector<TDbDocument>::const_iterator begin = docs.cbegin();
-    std::unordered_map<size_t, size_t> oldLabelsToNew;
+    // Chunks are independent, so they can be clustered concurrently
+    std::vector<std::pair<size_t, size_t>> batches;
     size_t batchStart = 0;
     size_t prevBatchEnd = batchStart;
-    size_t maxLabel = 0;
-    while (prevBatchEnd < docs.size()) {
+    while (prevBatchEnd < docSize) {
         size_t remainingDocsCount = docSize - batchStart;
-        size_t batchSize = std::min(remainingDocsCount, static_cast<size_t>(Config.chunk_size()));
-        std::vector<TDbDocument>::const_iterator end = begin + batchSize;
+        size_t batchSize = std::min(remainingDocsCount, GetChunkSize(docSize));
+        batches.emplace_back(batchStart, batchSize);
+        prevBatchEnd = batchStart + batchSize;
+        batchStart = prevBatchEnd - intersectionSize;
+    }
+    std::vector<std::vector<size_t>> batchesLabels(batches.size());
+    if (ThreadPool && Config.chunk_threads() > 1 && batches.size() > 1) {
+        ThreadPool->ParallelFor(0, batches.size(), [&](size_t batchNumber) {
+            const auto& [start, size] = batches[batchNumber];
+            batchesLabels[batchNumber] = ClusterBatch(docs, start, start + size, embeddingKeysWeights);
+        });
+    } else {
+        for (size_t batchNumber = 0; batchNumber < batches.size(); ++batchNumber) {
+            const auto& [start, size] = batches[batchNumber];
+            batchesLabels[batchNumber] = ClusterBatch(docs, start, start + size, embeddingKeysWeights);
+        }
+    }
 
-        std::vector<size_t> newLabels = ClusterBatch(begin, end, embeddingKeysWeights);
+    // Merge labels of the overlapping chunks
+    std::vector<size_t> labels;
+    labels.reserve(docSize);
+    std::unordered_map<size_t, size_t> oldLabelsToNew;
+    size_t maxLabel = 0;
+    for (size_t batchNumber = 0; batchNumber < batches.size(); ++batchNumber) {
+        const size_t start = batches[batchNumber].first;
+        std::vector<size_t>& newLabels = batchesLabels[batchNumber];
         std::for_each(newLabels.begin(), newLabels.end(), [&](size_t& i){ i += maxLabel; });
         maxLabel = *std::max_element(newLabels.begin(), newLabels.end());
 
-        assert(begin->Url == docs[batchStart].Url);
-        for (size_t i = batchStart; i < batchStart + intersectionSize && i < labels.size(); i++) {
+        for (size_t i = start; i < start + intersectionSize && i < labels.size(); i++) {
             size_t oldLabel = labels[i];
-            size_t batchIndex = static_cast<size_t>(i - batchStart);
+            size_t batchIndex = static_cast<size_t>(i - start);
             size_t newLabel = newLabels.at(batchIndex);
             oldLabelsToNew[oldLabel] = newLabel;
         }
-        if (batchStart == 0) {
+        if (start == 0) {
             for (size_t i = 0; i < std::min(intersectionSize, newLabels.size()); i++) {
                 labels.push_back(newLabels[i]);
             }
@@ -111,17 +192,12 @@ TClusters TSlinkClustering::Cluster(
         for (size_t i = intersectionSize; i < newLabels.size(); i++) {
             labels.push_back(newLabels[i]);
         }
-        assert(batchStart == static_cast<size_t>(std::distance(docs.begin(), begin)));
-        assert(batchStart + batchSize == static_cast<size_t>(std::distance(docs.begin(), end)));
         for (const auto& pair : oldLabelsToNew) {
             assert(pair.first < pair.second);
         }
-
-        prevBatchEnd = batchStart + batchSize;
-        batchStart = prevBatchEnd - intersectionSize;
-        begin = end - intersectionSize;
+        std::vector<size_t>().swap(newLabels);
     }
-    assert(labels.size() == docs.size());
+    assert(labels.size() == docs.Size());
     for (auto& label : labels) {
         auto it = oldLabelsToNew.find(label);
         if (it == oldLabelsToNew.end()) {
@@ -129,37 +205,109 @@ TClusters TSlinkClustering::Cluster(
         }
         label = it->second;
     }
+    return labels;
+}
 
-    std::unordered_map<size_t, size_t> clusterLabels;
-    TClusters clusters;
-    for (size_t i = 0; i < docSize; ++i) {
-        const size_t clusterId = labels[i];
-        auto it = clusterLabels.find(clusterId);
-        if (it == clusterLabels.end()) {
-            size_t newLabel = clusters.size();
-            clusterLabels[clusterId] = newLabel;
-            clusters.emplace_back(newLabel);
-            clusters[newLabel].AddDocument(docs[i]);
-        } else {
-            clusters[it->second].AddDocument(docs[i]);
+std::vector<size_t> TSlinkClustering::CalcLabels(
+    const TDocumentArena& docs,
+    const TClusteringState& state,
+    const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
+) const {
+    // Documents go from the freshest to the oldest, so new documents are expected in the head
+    size_t headSize = 0;
+    for (size_t i = 0; i < docs.Size(); ++i) {
+        if (state.Labels.find(docs[i].FileName) == state.Labels.end()) {
+            headSize = i + 1;
         }
     }
-    return clusters;
+    const size_t intersectionSize = Config.intersection_size();
+    if (state.Labels.empty() || headSize + intersectionSize > GetChunkSize(docs.Size())) {
+        return CalcLabels(docs, embeddingKeysWeights);
+    }
+
+    // Head is clustered as a new chunk. Old clusters keep their labels, a cluster with documents in the intersection
+    // joins the new cluster of its freshest intersection document that still fits the size and host limits.
+    std::vector<size_t> labels;
+    if (headSize != 0) {
+        labels = ClusterBatch(docs, 0, std::min(docs.Size(), headSize + intersectionSize), embeddingKeysWeights);
+        std::for_each(labels.begin(), labels.end(), [&](size_t& i){ i += state.MaxLabel + 1; });
+    }
+    const size_t batchSize = labels.size();
+
+    // Old clusters are joined by their documents out of the batch
+    std::unordered_map<size_t, size_t> oldClusterSizes;
+    std::unordered_map<size_t, TClusterSiteNames> oldClusterSiteNames;
+    for (size_t i = batchSize; i < docs.Size(); i++) {
+        const size_t oldLabel = state.Labels.at(docs[i].FileName);
+        oldClusterSizes[oldLabel] += 1;
+        if (Config.ban_same_hosts()) {
+            oldClusterSiteNames[oldLabel].insert(docs[i].SiteName);
+        }
+    }
+    std::unordered_map<size_t, size_t> newClusterSizes;
+    std::unordered_map<size_t, TClusterSiteNames> newClusterSiteNames;
+    for (size_t i = 0; i < batchSize; i++) {
+        newClusterSizes[labels[i]] += 1;
+        if (Config.ban_same_hosts()) {
+            newClusterSiteNames[labels[i]].insert(docs[i].SiteName);
+        }
+    }
+
+    std::unordered_map<size_t, size_t> oldLabelsToNew;
+    for (size_t i = headSize; i < batchSize; i++) {
+        const size_t oldLabel = state.Labels.at(docs[i].FileName);
+        if (oldLabelsToNew.find(oldLabel) != oldLabelsToNew.end() || oldClusterSizes.find(oldLabel) == oldClusterSizes.end()) {
+            continue;
+        }
+        const size_t newLabel = labels[i];
+        const size_t joinedSize = newClusterSizes[newLabel] + oldClusterSizes[oldLabel];
+        if (joinedSize > Config.large_cluster_size()) {
+            continue;
+        }
+        if (Config.ban_same_hosts()) {
+            TClusterSiteNames& siteNames = newClusterSiteNames[newLabel];
+            const TClusterSiteNames& oldSiteNames = oldClusterSiteNames[oldLabel];
+            if (HasSameSource(siteNames, oldSiteNames)) {
+                continue;
+            }
+            siteNames.insert(oldSiteNames.begin(), oldSiteNames.end());
+        }
+        newClusterSizes[newLabel] = joinedSize;
+        oldLabelsToNew[oldLabel] = newLabel;
+    }
+
+    labels.reserve(docs.Size());
+    for (size_t i = batchSize; i < docs.Size(); i++) {
+        const size_t oldLabel = state.Labels.at(docs[i].FileName);
+        auto it = oldLabelsToNew.find(oldLabel);
+        labels.push_back(it != oldLabelsToNew.end() ? it->second : oldLabel);
+    }
+    return labels;
+}
+
+size_t TSlinkClustering::GetChunkSize(size_t docSize) const {
+    // Zero chunk size means no chunking
+    return Config.chunk_size() != 0 ? static_cast<size_t>(Config.chunk_size()) : docSize;
 }
 
 // SLINK: https://sites.cs.ucsb.edu/~veronika/MAE/summary_SLINK_Sibson72.pdf
 std::vector<size_t> TSlinkClustering::ClusterBatch(
-    const std::vector<TDbDocument>::const_iterator begin,
-    const std::vector<TDbDocument>::const_iterator end,
+    const TDocumentArena& docs,
+    size_t batchBegin,
+    size_t batchEnd,
     const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
-) {
-    const size_t docSize = std::distance(begin, end);
+) const {
+    if (Config.knn_size() != 0) {
+        return ClusterBatchSparse(docs, batchBegin, batchEnd, embeddingKeysWeights);
+    }
+
+    const size_t docSize = batchEnd - batchBegin;
     assert(docSize != 0);
 
-    Eigen::MatrixXf distances = CalcDistances(begin, end, embeddingKeysWeights);
+    Eigen::MatrixXf distances = CalcDistances(docs, batchBegin, batchEnd, embeddingKeysWeights);
 
     if (Config.use_timestamp_moving()) {
-        ApplyTimePenalty(begin, docSize, distances);
+        ApplyTimePenalty(docs, batchBegin, docSize, distances);
     }
 
     // Prepare 3 arrays
@@ -178,15 +326,12 @@ std::vector<size_t> TSlinkClustering::ClusterBatch(
     // Cluster meta
     std::vector<size_t> clusterSizes(docSize);
     std::vector<TClusterSiteNames> clusterSiteNames(docSize);
-    auto it = begin;
     for (size_t i = 0; i < docSize; i++) {
         clusterSizes[i] = 1;
         if (Config.ban_same_hosts()) {
-            clusterSiteNames[i].insert(it->SiteName);
-            ++it;
+            clusterSiteNames[i].insert(docs[batchBegin + i].SiteName);
         }
     }
-    assert(!Config.ban_same_hosts() || it == end);
 
     // Main linking loop
     float prevStepMinDistance = 0.0f;
@@ -273,29 +418,151 @@ std::vector<size_t> TSlinkClustering::ClusterBatch(
     return labels;
 }
 
+// Single linkage over the k nearest neighbours graph: Kruskal's MST with the same size and host constraints.
+// Only O(n * k) distances are kept, the full distance matrix is never materialized.
+std::vector<size_t> TSlinkClustering::ClusterBatchSparse(
+    const TDocumentArena& docs,
+    size_t batchBegin,
+    size_t batchEnd,
+    const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
+) const {
+    const size_t docSize = batchEnd - batchBegin;
+    assert(docSize != 0);
+    const size_t knnSize = std::min(static_cast<size_t>(Config.knn_size()), docSize - 1);
+
+    // Normalized points for every embedding key
+    std::vector<const TEmbeddingMatrix*> keysEmbeddings;
+    std::vector<float> keysWeights;
+    for (const auto& [embeddingKey, weight] : embeddingKeysWeights) {
+        keysEmbeddings.push_back(&docs.GetEmbeddings(embeddingKey));
+        keysWeights.push_back(weight);
+    }
+
+    // Nearest neighbours graph, calculated by blocks of columns
+    std::vector<TDistanceEdge> edges;
+    edges.reserve(docSize * knnSize);
+    std::vector<TDistanceEdge> candidates;
+    candidates.reserve(docSize);
+    for (size_t blockStart = 0; blockStart < docSize; blockStart += KNN_BLOCK_SIZE) {
+        const size_t blockSize = std::min(KNN_BLOCK_SIZE, docSize - blockStart);
+        Eigen::MatrixXf distances = Eigen::MatrixXf::Zero(docSize, blockSize);
+        for (size_t keyIndex = 0; keyIndex < keysEmbeddings.size(); ++keyIndex) {
+            const TEmbeddingMatrix& embeddings = *keysEmbeddings[keyIndex];
+            const auto points = embeddings.GetMatrix().middleRows(batchBegin, docSize);
+            const float weight = keysWeights[keyIndex];
+
+            Eigen::MatrixXf keyDistances = (points * points.middleRows(blockStart, blockSize).transpose());
+            keyDistances = (-(keyDistances.array() + 1.0f) / 2.0f + 1.0f) * weight;
+            for (size_t i = 0; i < docSize; ++i) {
+                if (embeddings.IsBadRow(batchBegin + i)) {
+                    keyDistances.row(i).setConstant(weight);
+                }
+            }
+            for (size_t j = 0; j < blockSize; ++j) {
+                if (embeddings.IsBadRow(batchBegin + blockStart + j)) {
+                    keyDistances.col(j).setConstant(weight);
+                }
+            }
+            distances += keyDistances.cwiseMax(0.0f);
+        }
+
+        for (size_t j = 0; j < blockSize; ++j) {
+            const size_t docIndex = blockStart + j;
+            const uint64_t docTs = docs[batchBegin + docIndex].FetchTime;
+            candidates.clear();
+            for (size_t i = 0; i < docSize; ++i) {
+                if (i == docIndex) {
+                    continue;
+                }
+                float distance = distances(i, j);
+                if (Config.use_timestamp_moving()) {
+                    distance = std::min(CalcTimePenalty(docTs, docs[batchBegin + i].FetchTime) * distance, INF_DISTANCE);
+                }
+                // Longer edges are never linked
+                if (distance > Config.small_threshold()) {
+                    continue;
+                }
+                candidates.push_back({distance, static_cast<uint32_t>(docIndex), static_cast<uint32_t>(i)});
+            }
+            auto byDistance = [](const TDistanceEdge& a, const TDistanceEdge& b) {
+                return a.Distance < b.Distance;
+            };
+            if (candidates.size() > knnSize) {
+                std::nth_element(candidates.begin(), candidates.begin() + knnSize, candidates.end(), byDistance);
+                candidates.resize(knnSize);
+            }
+            edges.insert(edges.end(), candidates.begin(), candidates.end());
+        }
+    }
+    std::sort(edges.begin(), edges.end(), [](const TDistanceEdge& a, const TDistanceEdge& b) {
+        if (a.Distance != b.Distance) {
+            return a.Distance < b.Distance;
+        }
+        if (a.From != b.From) {
+            return a.From < b.From;
+        }
+        return a.To < b.To;
+    });
+
+    // Cluster meta
+    std::vector<size_t> parents(docSize);
+    std::vector<size_t> clusterSizes(docSize, 1);
+    std::vector<TClusterSiteNames> clusterSiteNames(docSize);
+    for (size_t i = 0; i < docSize; ++i) {
+        parents[i] = i;
+        if (Config.ban_same_hosts()) {
+            clusterSiteNames[i].insert(docs[batchBegin + i].SiteName);
+        }
+    }
+
+    // Main linking loop
+    for (const TDistanceEdge& edge : edges) {
+        const size_t firstRoot = FindRoot(parents, edge.From);
+        const size_t secondRoot = FindRoot(parents, edge.To);
+        if (firstRoot == secondRoot) {
+            continue;
+        }
+        const size_t newClusterSize = clusterSizes[firstRoot] + clusterSizes[secondRoot];
+        const bool isAcceptableSize = IsNewClusterSizeAcceptable(newClusterSize, edge.Distance, Config);
+        const bool hasSameSource = Config.ban_same_hosts() && HasSameSource(clusterSiteNames[firstRoot], clusterSiteNames[secondRoot]);
+        if (!isAcceptableSize || hasSameSource) {
+            continue;
+        }
+
+        // Link secondRoot to firstRoot
+        parents[secondRoot] = firstRoot;
+        clusterSizes[firstRoot] = newClusterSize;
+        if (Config.ban_same_hosts()) {
+            clusterSiteNames[firstRoot].insert(clusterSiteNames[secondRoot].begin(), clusterSiteNames[secondRoot].end());
+            clusterSiteNames[secondRoot].clear();
+        }
+    }
+
+    std::vector<size_t> labels(docSize);
+    for (size_t i = 0; i < docSize; ++i) {
+        labels[i] = FindRoot(parents, i);
+    }
+    return labels;
+}
+
 Eigen::MatrixXf TSlinkClustering::CalcDistances(
-    const std::vector<TDbDocument>::const_iterator begin,
-    const std::vector<TDbDocument>::const_iterator end,
+    const TDocumentArena& docs,
+    size_t batchBegin,
+    size_t batchEnd,
     const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights) const
 {
-    const size_t docSize = std::distance(begin, end);
+    const size_t docSize = batchEnd - batchBegin;
     assert(docSize != 0);
 
     Eigen::MatrixXf finalDistances = Eigen::MatrixXf::Zero(docSize, docSize);
     for (const auto& [embeddingKey, weight] : embeddingKeysWeights) {
-        const size_t embSize = begin->Embeddings.at(embeddingKey).size();
-        Eigen::MatrixXf points(docSize, embSize);
+        const TEmbeddingMatrix& embeddings = docs.GetEmbeddings(embeddingKey);
+        const auto points = embeddings.GetMatrix().middleRows(batchBegin, docSize);
         std::vector<size_t> badPoints;
-        std::vector<TDbDocument>::const_iterator docsIt = begin;
         for (size_t i = 0; i < docSize; ++i) {
-            std::vector<float> embedding = docsIt->Embeddings.at(embeddingKey);
-            Eigen::Map<Eigen::VectorXf, Eigen::Unaligned> docVector(embedding.data(), embedding.size());
-            if (std::abs(docVector.norm() - 0.0) > 0.00000001) {
-                points.row(i) = docVector / docVector.norm();
-            } else {
+            if (embeddings.IsBadRow(batchBegin + i)) {
                 badPoints.push_back(i);
             }
-            docsIt++;
         }
 
         // Assuming points are on unit sphere
@@ -2,29 +2,57 @@
 
 #include "clustering.h"
 #include "config.pb.h"
+#include "../work_stealing_pool.h"
 
 #include <Eigen/Core>
 
 class TSlinkClustering : public TClustering {
 public:
-    explicit TSlinkClustering(const tg::TClusteringConfig& config);
+    // Chunks are clustered in the pool if chunk_threads > 1, the pool is not owned
+    explicit TSlinkClustering(const tg::TClusteringConfig& config, TWorkStealingPool* threadPool = nullptr);
 
     TClusters Cluster(
-        const std::vector<TDbDocument>& docs
+        const TDocumentArenaPtr& docs
+    ) override;
+
+    // Only documents that are missing in the state are linked together with the intersection, others keep their labels.
+    // Old documents out of the intersection are never re-linked, so the result may differ from the full pass.
+    TClusters Cluster(
+        const TDocumentArenaPtr& docs,
+        TClusteringState& state
     ) override;
 
 private:
+    std::vector<size_t> CalcLabels(
+        const TDocumentArena& docs,
+        const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
+    ) const;
+    std::vector<size_t> CalcLabels(
+        const TDocumentArena& docs,
+        const TClusteringState& state,
+        const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
+    ) const;
     Eigen::MatrixXf CalcDistances(
-        const std::vector<TDbDocument>::const_iterator begin,
-        const std::vector<TDbDocument>::const_iterator end,
+        const TDocumentArena& docs,
+        size_t batchBegin,
+        size_t batchEnd,
         const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
     ) const;
     std::vector<size_t> ClusterBatch(
-        const std::vector<TDbDocument>::const_iterator begin,
-        const std::vector<TDbDocument>::const_iterator end,
+        const TDocumentArena& docs,
+        size_t batchBegin,
+        size_t batchEnd,
         const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
-    );
+    ) const;
+    std::vector<size_t> ClusterBatchSparse(
+        const TDocumentArena& docs,
+        size_t batchBegin,
+        size_t batchEnd,
+        const std::unordered_map<tg::EEmbeddingKey, float>& embeddingKeysWeights
+    ) const;
+    size_t GetChunkSize(size_t docSize) const;
 
 private:
     tg::TClusteringConfig Config;
+    TWorkStealingPool* ThreadPool = nullptr;
 };
@@ -2,19 +2,39 @@
 
 #include "document.h"
 #include "document.pb.h"
+#include "document_snapshot.h"
 #include "util.h"
 
+#include <boost/algorithm/string.hpp>
+#include <trantor/net/EventLoop.h>
+
 #include <optional>
-#include <tinyxml2/tinyxml2.h>
+#include <vector>
 
 namespace {
+    constexpr size_t THREADS_LIMIT = 1000;
+
+    using THttpCallback = std::function<void(const drogon::HttpResponsePtr&)>;
+    using THttpCallbackPtr = std::shared_ptr<THttpCallback>;
+
+    drogon::HttpResponsePtr MakeStatusResponse(drogon::HttpStatusCode code) {
+        auto resp = drogon::HttpResponse::newHttpResponse();
+        resp->setStatusCode(code);
+        return resp;
+    }
+
     void MakeSimpleResponse(
         std::function<void(const drogon::HttpResponsePtr&)>&& callback,
         drogon::HttpStatusCode code = drogon::k400BadRequest
     ) {
-        auto resp = drogon::HttpResponse::newHttpResponse();
-        resp->setStatusCode(code);
-        callback(resp);
+        callback(MakeStatusResponse(code));
+    }
+
+    // Requests processed in other threads are answered from the IO loop of the request
+    void SendInLoop(trantor::EventLoop* loop, const THttpCallbackPtr& callback, drogon::HttpResponsePtr resp) {
+        loop->queueInLoop([callback, resp = std::move(resp)]() {
+            (*callback)(resp);
+        });
     }
 
     std::optional<int64_t> ParseTtlHeader(const std::string& value) try {
@@ -43,6 +63,43 @@ namespace {
         return category != tg::NC_UNDEFINED ? std::make_optional(category) : std::nullopt;
     }
 
+    double ParseQValue(const std::string& value) try {
+        return std::stod(value);
+    } catch (const std::exception& e) {
+        return 0.0;
+    }
+
+    // Accept-Encoding with q-values: "gzip;q=0" refuses gzip, "*" accepts it if gzip is not listed
+    bool AcceptsGzip(const std::string& header) {
+        std::optional<bool> gzip;
+        std::optional<bool> any;
+        std::vector<std::string> codings;
+        boost::split(codings, header, boost::is_any_of(","));
+        for (const std::string& coding : codings) {
+            std::vector<std::string> params;
+            boost::split(params, coding, boost::is_any_of(";"));
+            const std::string name = boost::to_lower_copy(boost::trim_copy(params[0]));
+            double q = 1.0;
+            for (size_t i = 1; i < params.size(); ++i) {
+                const std::string param = boost::trim_copy(params[i]);
+                if (boost::istarts_with(param, "q=")) {
+                    q = ParseQValue(param.substr(2));
+                }
+            }
+            if (name == "gzip" || name == "x-gzip") {
+                gzip = q > 0.0;
+            } else if (name == "*") {
+                any = q > 0.0;
+            }
+        }
+        return gzip.value_or(any.value_or(false));
+    }
+
+    bool HasPrecomputedTop(const TClusterIndex& index, tg::ELanguage lang, uint64_t period) {
+        const auto langTopsIt = index.Tops.find(lang);
+        return langTopsIt != index.Tops.end() && langTopsIt->second.count(period) != 0;
+    }
+
     Json::Value ToJson(const TNewsCluster& cluster) {
         Json::Value articles(Json::arrayValue);
         for (const auto& document : cluster.GetDocuments()) {
@@ -60,13 +117,19 @@ namespace {
 void TController::Init(
     const THotState<TClusterIndex>* index,
     rocksdb::DB* db,
-    std::unique_ptr<TAnnotator> annotator,
-    std::unique_ptr<TRanker> ranker
+    TDocumentCache* cache,
+    std::unique_ptr<TAnnotationExecutor> annotationExecutor,
+    std::unique_ptr<TRanker> ranker,
+    std::unique_ptr<TThreadsResponseCache> threadsCache,
+    std::unique_ptr<TThreadPool> rankingPool
 ) {
     Index = index;
     Db = db;
-    Annotator = std::move(annotator);
+    Cache = cache;
+    AnnotationExecutor = std::move(annotationExecutor);
     Ranker = std::move(ranker);
+    ThreadsCache = std::move(threadsCache);
+    RankingPool = std::move(rankingPool);
     Initialized.store(true, std::memory_order_release);
 }
 
@@ -79,16 +142,32 @@ bool TController::IsNotReady(std::function<void(const drogon::HttpResponsePtr&)>
     return true;
 }
 
-std::optional<TDbDocument> TController::ParseDbDocFromReq(
+void TController::AnnotateAndRespond(
     const drogon::HttpRequestPtr& req,
-    const std::string& fname
+    const std::string& fname,
+    std::function<void(const drogon::HttpResponsePtr&)>&& callback,
+    TAnnotatedHandler&& onAnnotated
 ) const {
-    tinyxml2::XMLDocument html;
-    const tinyxml2::XMLError parseCode = html.Parse(req->bodyData(), req->bodyLength());
-    if (parseCode != tinyxml2::XML_SUCCESS) {
-        return std::nullopt;
+    // The handler writes to the database in the executor thread, only the response is sent from the IO loop
+    trantor::EventLoop* loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    auto sharedCallback = std::make_shared<THttpCallback>(std::move(callback));
+    const bool accepted = AnnotationExecutor->Annotate(
+        std::string(req->bodyData(), req->bodyLength()),
+        fname,
+        [loop, sharedCallback, fname, onAnnotated = std::move(onAnnotated)](TAnnotationExecutor::TResult&& result) {
+            drogon::HttpResponsePtr resp;
+            try {
+                resp = onAnnotated(std::move(result));
+            } catch (const std::exception& e) {
+                LOG_ERROR("Indexing of " << fname << " failed: " << e.what());
+                resp = MakeStatusResponse(drogon::k500InternalServerError);
+            }
+            SendInLoop(loop, sharedCallback, std::move(resp));
+        }
+    );
+    if (!accepted) {
+        MakeSimpleResponse(std::move(*sharedCallback), drogon::k503ServiceUnavailable);
     }
-    return Annotator->AnnotateHtml(html, fname);
 }
 
 bool TController::IndexDbDoc(const TDbDocument& dbDoc, const std::string& fname) const {
@@ -98,13 +177,9 @@ bool TController::IndexDbDoc(const TDbDocument& dbDoc, const std::string& fname)
     if (!success) {
         return false;
     }
-    // TODO: possible races while the same fname is provided to multiple queries
-    // TODO: use "value_found" flag and check DB instead of only bloom filter
-    const rocksdb::Status status= Db->Put(rocksdb::WriteOptions(), fname, serializedDoc);
-    if (!status.ok()) {
-        return false;
-    }
-    return true;
+    return Cache->Put(dbDoc, TDocumentSnapshot::HashValue(serializedDoc), [&] {
+        return Db->Put(rocksdb::WriteOptions(), fname, serializedDoc).ok();
+    });
 }
 
 drogon::HttpStatusCode TController::GetCode(
@@ -112,9 +187,7 @@ drogon::HttpStatusCode TController::GetCode(
     drogon::HttpStatusCode createdCode,
     drogon::HttpStatusCode existedCode
 ) const {
-    std::string value;
-    const auto mayExist = Db->KeyMayExist(rocksdb::ReadOptions(), fname, &value);
-    return mayExist ? existedCode : createdCode;
+    return Cache->Contains(fname) ? existedCode : createdCode;
 };
 
 
@@ -133,25 +206,35 @@ void TController::Put(
         return;
     }
 
-    std::optional<TDbDocument> dbDoc = ParseDbDocFromReq(req, fname);
+    AnnotateAndRespond(req, fname, std::move(callback), [this, ttl = ttl.value(), fname](TAnnotationExecutor::TResult&& result) {
+        return OnPutAnnotated(std::move(result), ttl, fname);
+    });
+}
+
+drogon::HttpResponsePtr TController::OnPutAnnotated(
+    TAnnotationExecutor::TResult&& result,
+    int64_t ttl,
+    const std::string& fname
+) const {
+    if (result.Failed) {
+        return MakeStatusResponse(drogon::k500InternalServerError);
+    }
+    std::optional<TDbDocument>& dbDoc = result.Document;
     if (!dbDoc) {
-        MakeSimpleResponse(std::move(callback), drogon::k400BadRequest);
-        return;
+        return MakeStatusResponse(drogon::k400BadRequest);
     }
-    dbDoc->Ttl = ttl.value();
+    dbDoc->Ttl = ttl;
 
     if (!dbDoc->IsFullyIndexed()) {
-        MakeSimpleResponse(std::move(callback), drogon::k204NoContent);
-        return;
+        return MakeStatusResponse(drogon::k204NoContent);
     }
 
     const drogon::HttpStatusCode code = GetCode(fname, drogon::k201Created, drogon::k204NoContent);
     bool success = IndexDbDoc(dbDoc.value(), fname);
     if (!success) {
-        MakeSimpleResponse(std::move(callback), drogon::k500InternalServerError);
-        return;
+        return MakeStatusResponse(drogon::k500InternalServerError);
     }
-    MakeSimpleResponse(std::move(callback), code);
+    return MakeStatusResponse(code);
 }
 
 void TController::Delete(
@@ -164,19 +247,17 @@ void TController::Delete(
         return;
     }
 
-    // TODO: possible races while the same fname is provided to multiple queries
-    // TODO: use "value_found" flag and check DB instead of only bloom filter
-    std::string value;
-    const bool mayExist = Db->KeyMayExist(rocksdb::ReadOptions(), fname, &value);
-    if (mayExist) {
-        const rocksdb::Status s = Db->Delete(rocksdb::WriteOptions(), fname);
-        if (!s.ok()) {
-            MakeSimpleResponse(std::move(callback), drogon::k500InternalServerError);
-            return;
-        }
+    bool dbFailed = false;
+    const bool existed = Cache->Delete(fname, [&] {
+        dbFailed = !Db->Delete(rocksdb::WriteOptions(), fname).ok();
+        return !dbFailed;
+    });
+    if (dbFailed) {
+        MakeSimpleResponse(std::move(callback), drogon::k500InternalServerError);
+        return;
     }
 
-    MakeSimpleResponse(std::move(callback), mayExist ? drogon::k204NoContent : drogon::k404NotFound);
+    MakeSimpleResponse(std::move(callback), existed ? drogon::k204NoContent : drogon::k404NotFound);
 }
 
 void TController::Threads(
@@ -196,19 +277,101 @@ void TController::Threads(
         return;
     }
 
-    const std::shared_ptr<TClusterIndex> index = Index->AtomicGet();
+    const bool acceptsGzip = AcceptsGzip(req->getHeader("Accept-Encoding"));
+    TThreadsResponseCache::TKey key{0, lang.value(), category.value(), period.value()};
+    {
+        const auto index = Index->Pin();
+        key.Generation = index->Generation;
+    }
+    TThreadsResponseCache::TResponsePtr cached = ThreadsCache->Get(key);
+    if (cached) {
+        SendThreadsResponse(*cached, acceptsGzip, std::move(callback));
+        return;
+    }
 
-    const auto& clusters = index->Clusters.at(lang.value()); // TODO: possible missing key
-    const uint64_t fromTimestamp = index->TrueMaxTimestamp > period.value() ? index->TrueMaxTimestamp - period.value() : 0;
+    // Cache misses are ranked and serialized in the CPU pool, the response is sent from the IO loop of the request
+    trantor::EventLoop* loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    auto sharedCallback = std::make_shared<THttpCallback>(std::move(callback));
+    const bool accepted = RankingPool->tryEnqueue([this, key, acceptsGzip, loop, sharedCallback]() {
+        TThreadsResponseCache::TResponsePtr response;
+        try {
+            // The index is pinned only while the body is built, the cached body outlives it
+            const auto index = Index->Pin();
+            TThreadsResponseCache::TKey currentKey = key;
+            currentKey.Generation = index->Generation;
+            // Other periods are ranked on each request, caching them would let clients grow the cache without limit
+            const bool cacheable = HasPrecomputedTop(*index, key.Language, key.Period);
+            if (cacheable) {
+                response = ThreadsCache->Get(currentKey);
+            }
+            if (!response) {
+                std::string body = MakeThreadsBody(*index, key.Language, key.Category, key.Period);
+                response = cacheable
+                    ? ThreadsCache->Put(currentKey, std::move(body))
+                    : ThreadsCache->MakeResponse(std::move(body));
+            }
+        } catch (const std::exception& e) {
+            // An exception would terminate the pool thread, the request is answered anyway
+            LOG_ERROR("Threads response failed: " << e.what());
+            SendInLoop(loop, sharedCallback, MakeStatusResponse(drogon::k500InternalServerError));
+            return;
+        }
+        loop->queueInLoop([this, response, acceptsGzip, sharedCallback]() {
+            SendThreadsResponse(*response, acceptsGzip, std::move(*sharedCallback));
+        });
+    });
+    if (!accepted) {
+        MakeSimpleResponse(std::move(*sharedCallback), drogon::k503ServiceUnavailable);
+    }
+}
 
-    const auto indexIt = std::lower_bound(clusters.cbegin(), clusters.cend(), fromTimestamp, TNewsCluster::Compare);
-    const auto weightedClusters = Ranker->Rank(indexIt, clusters.cend(), index->IterTimestamp, period.value());
-    const auto& categoryClusters = weightedClusters.at(category.value());
+void TController::SendThreadsResponse(
+    const TThreadsResponseCache::TResponse& response,
+    bool acceptsGzip,
+    std::function<void(const drogon::HttpResponsePtr&)>&& callback
+) const {
+    auto resp = drogon::HttpResponse::newHttpResponse();
+    resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    resp->addHeader("Vary", "Accept-Encoding");
+    if (acceptsGzip && !response.GzippedBody.empty()) {
+        resp->addHeader("Content-Encoding", "gzip");
+        resp->setBody(response.GzippedBody);
+    } else {
+        resp->setBody(response.Body);
+    }
+    callback(resp);
+}
 
+std::string TController::MakeThreadsBody(
+    const TClusterIndex& index,
+    tg::ELanguage lang,
+    tg::ECategory category,
+    uint64_t period
+) const {
+    // Tops for the period buckets are precomputed by the clustering thread
+    std::vector<TWeightedNewsCluster> rankedClusters;
+    const std::vector<TWeightedNewsCluster>* categoryClusters = nullptr;
+    const auto langTopsIt = index.Tops.find(lang);
+    if (langTopsIt != index.Tops.end()) {
+        const auto periodTopsIt = langTopsIt->second.find(period);
+        if (periodTopsIt != langTopsIt->second.end()) {
+            categoryClusters = &periodTopsIt->second.at(category);
+        }
+    }
+    const auto clustersIt = index.Clusters.find(lang);
+    if (!categoryClusters && clustersIt != index.Clusters.end()) {
+        const auto& clusters = clustersIt->second;
+        const uint64_t fromTimestamp = index.TrueMaxTimestamp > period ? index.TrueMaxTimestamp - period : 0;
+        const auto indexIt = std::lower_bound(clusters.cbegin(), clusters.cend(), fromTimestamp, TNewsCluster::Compare);
+        rankedClusters = Ranker->RankTop(indexIt, clusters.cend(), index.IterTimestamp, period, category, THREADS_LIMIT);
+        categoryClusters = &rankedClusters;
+    }
+
+    // Languages without clustering have no threads
     Json::Value threads(Json::arrayValue);
-    int limit = 1000;
-    for (const auto& weightedCluster : categoryClusters) {
-        if (limit <= 0) {
+    size_t limit = THREADS_LIMIT;
+    for (const auto& weightedCluster : categoryClusters ? *categoryClusters : rankedClusters) {
+        if (limit == 0) {
             break;
         }
         const TNewsCluster& cluster = weightedCluster.Cluster.get();
@@ -218,8 +381,10 @@ void TController::Threads(
 
     Json::Value json(Json::objectValue);
     json["threads"] = std::move(threads);
-    auto resp = drogon::HttpResponse::newHttpJsonResponse(json);
-    callback(resp);
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, json);
 }
 
 void TController::Get(
@@ -270,20 +435,31 @@ void TController::Post(
         return;
     }
 
-    std::optional<TDbDocument> dbDoc = ParseDbDocFromReq(req, fname);
+    AnnotateAndRespond(req, fname, std::move(callback), [this, ttl = ttl.value(), fname](TAnnotationExecutor::TResult&& result) {
+        return OnPostAnnotated(std::move(result), ttl, fname);
+    });
+}
+
+drogon::HttpResponsePtr TController::OnPostAnnotated(
+    TAnnotationExecutor::TResult&& result,
+    int64_t ttl,
+    const std::string& fname
+) const {
+    if (result.Failed) {
+        return MakeStatusResponse(drogon::k500InternalServerError);
+    }
+    std::optional<TDbDocument>& dbDoc = result.Document;
     if (!dbDoc) {
-        MakeSimpleResponse(std::move(callback), drogon::k400BadRequest);
-        return;
+        return MakeStatusResponse(drogon::k400BadRequest);
     }
 
     drogon::HttpStatusCode code = GetCode(fname, drogon::k201Created, drogon::k200OK);
-    bool isIndexed = dbDoc->IsFullyIndexed() && ttl.value() != -1;
+    bool isIndexed = dbDoc->IsFullyIndexed() && ttl != -1;
     if (isIndexed) {
-        dbDoc->Ttl = ttl.value();
+        dbDoc->Ttl = ttl;
         bool success = IndexDbDoc(dbDoc.value(), fname);
         if (!success) {
-            MakeSimpleResponse(std::move(callback), drogon::k500InternalServerError);
-            return;
+            return MakeStatusResponse(drogon::k500InternalServerError);
         }
     } else {
         code = drogon::k200OK;
@@ -301,6 +477,6 @@ void TController::Post(
 
     auto resp = drogon::HttpResponse::newHttpJsonResponse(json);
     resp->setStatusCode(code);
-    callback(resp);
+    return resp;
 }
 
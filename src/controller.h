@@ -1,9 +1,12 @@
 #pragma once
 
-#include "annotator.h"
+#include "annotation_executor.h"
 #include "clusterer.h"
+#include "document_cache.h"
 #include "hot_state.h"
 #include "ranker.h"
+#include "response_cache.h"
+#include "thread_pool.h"
 
 #include <drogon/HttpController.h>
 #include <rocksdb/db.h>
@@ -21,8 +24,11 @@ public:
     void Init(
         const THotState<TClusterIndex>* index,
         rocksdb::DB* db,
-        std::unique_ptr<TAnnotator> annotator,
-        std::unique_ptr<TRanker> ranker
+        TDocumentCache* cache,
+        std::unique_ptr<TAnnotationExecutor> annotationExecutor,
+        std::unique_ptr<TRanker> ranker,
+        std::unique_ptr<TThreadsResponseCache> threadsCache,
+        std::unique_ptr<TThreadPool> rankingPool
     );
 
     void Put(
@@ -52,14 +58,38 @@ public:
 
 private:
     bool IsNotReady(std::function<void(const drogon::HttpResponsePtr&)> &&callback) const;
-    std::optional<TDbDocument> ParseDbDocFromReq(
+    using TAnnotatedHandler = std::function<drogon::HttpResponsePtr(TAnnotationExecutor::TResult&&)>;
+    void AnnotateAndRespond(
         const drogon::HttpRequestPtr& req,
+        const std::string& fname,
+        std::function<void(const drogon::HttpResponsePtr&)>&& callback,
+        TAnnotatedHandler&& onAnnotated
+    ) const;
+    drogon::HttpResponsePtr OnPutAnnotated(
+        TAnnotationExecutor::TResult&& result,
+        int64_t ttl,
+        const std::string& fname
+    ) const;
+    drogon::HttpResponsePtr OnPostAnnotated(
+        TAnnotationExecutor::TResult&& result,
+        int64_t ttl,
         const std::string& fname
     ) const;
     bool IndexDbDoc(
         const TDbDocument& dbDoc,
         const std::string& fname
     ) const;
+    void SendThreadsResponse(
+        const TThreadsResponseCache::TResponse& response,
+        bool acceptsGzip,
+        std::function<void(const drogon::HttpResponsePtr&)>&& callback
+    ) const;
+    std::string MakeThreadsBody(
+        const TClusterIndex& index,
+        tg::ELanguage lang,
+        tg::ECategory category,
+        uint64_t period
+    ) const;
     drogon::HttpStatusCode GetCode(
         const std::string& fname,
         drogon::HttpStatusCode createdCode,
@@ -72,6 +102,9 @@ private:
     const THotState<TClusterIndex>* Index;
 
     rocksdb::DB* Db;
-    std::unique_ptr<TAnnotator> Annotator;
+    TDocumentCache* Cache;
+    std::unique_ptr<TAnnotationExecutor> AnnotationExecutor;
     std::unique_ptr<TRanker> Ranker;
+    std::unique_ptr<TThreadsResponseCache> ThreadsCache;
+    std::unique_ptr<TThreadPool> RankingPool;
 };
@@ -4,6 +4,7 @@
 
 #include <nlohmann_json/json.hpp>
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -50,3 +51,5 @@ public:
 
     bool IsStale(uint64_t timestamp) const { return timestamp > FetchTime + Ttl; }
 };
+
+using TDbDocumentPtr = std::shared_ptr<const TDbDocument>;
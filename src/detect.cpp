@@ -5,17 +5,28 @@
 #include <algorithm>
 #include <optional>
 #include <sstream>
+#include <streambuf>
 
 #include <fasttext.h>
 
+namespace {
+
+// Read-only stream buffer over a string_view, fastText reads the text without a copy
+class TViewStreamBuf : public std::streambuf {
+public:
+    explicit TViewStreamBuf(std::string_view view) {
+        char* data = const_cast<char*>(view.data());
+        setg(data, data, data + view.size());
+    }
+};
+
+} // namespace
+
 std::optional<std::pair<std::string, double>> RunFasttextClf(
     const fasttext::FastText& model,
-    const std::string& originalText,
+    std::istream& ifs,
     double border)
 {
-    std::string text = originalText;
-    std::replace(text.begin(), text.end(), '\n', ' ');
-    std::istringstream ifs(text);
     std::vector<std::pair<fasttext::real, std::string>> predictions;
     model.predictLine(ifs, predictions, 1, border);
     if (predictions.empty()) {
@@ -68,7 +79,9 @@ bool TooManyUnknownSymbols(const TDocument& doc) {
 
 tg::ELanguage DetectLanguage(const fasttext::FastText& model, const TDocument& document) {
     std::string sample(document.Title + " " + document.Description + " " + document.Text.substr(0, 100));
-    auto pair = RunFasttextClf(model, sample, 0.4);
+    std::replace(sample.begin(), sample.end(), '\n', ' ');
+    std::istringstream ifs(sample);
+    auto pair = RunFasttextClf(model, ifs, 0.4);
     if (!pair) {
         return tg::LN_UNDEFINED;
     }
@@ -86,8 +99,10 @@ tg::ELanguage DetectLanguage(const fasttext::FastText& model, const TDocument& d
     return tg::LN_OTHER;
 }
 
-tg::ECategory DetectCategory(const fasttext::FastText& model, const std::string& title, const std::string& text) {
-    std::string sample(title + " " + text);
-    auto pair = RunFasttextClf(model, sample, 0.0);
+tg::ECategory DetectCategory(const fasttext::FastText& model, std::string_view text) {
+    // Space-separated tokens have no line breaks, the buffer is passed as is
+    TViewStreamBuf buffer(text);
+    std::istream ifs(&buffer);
+    auto pair = RunFasttextClf(model, ifs, 0.0);
     return pair ? FromString<tg::ECategory>(pair->first) : tg::NC_UNDEFINED;
 }
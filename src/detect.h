@@ -2,6 +2,8 @@
 
 #include "db_document.h"
 
+#include <string_view>
+
 namespace fasttext {
     class FastText;
 }
@@ -9,4 +11,5 @@ namespace fasttext {
 struct TDocument;
 
 tg::ELanguage DetectLanguage(const fasttext::FastText& model, const TDocument& document);
-tg::ECategory DetectCategory(const fasttext::FastText& model, const std::string& title, const std::string& text);
+// Text is the title and the text joined with a space
+tg::ECategory DetectCategory(const fasttext::FastText& model, std::string_view text);
@@ -1,11 +1,11 @@
 #include "document.h"
+#include "html_extractor.h"
+#include "mapped_file.h"
 #include "util.h"
 
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/filesystem.hpp>
 #include <tinyxml2/tinyxml2.h>
 
-#include <sstream>
 #include <fstream>
 
 TDocument::TDocument(const char* fileName) {
@@ -65,21 +65,16 @@ void TDocument::FromJson(const nlohmann::json& json) {
     }
 }
 
-std::string GetFullText(const tinyxml2::XMLElement* element) {
-    if (const tinyxml2::XMLText* textNode = element->ToText()) {
-        return textNode->Value();
-    }
-    std::string text;
+void AppendFullText(const tinyxml2::XMLElement* element, std::string* text) {
     const tinyxml2::XMLNode* node = element->FirstChild();
     while (node) {
         if (const tinyxml2::XMLElement* elementNode = node->ToElement()) {
-            text += GetFullText(elementNode);
+            AppendFullText(elementNode, text);
         } else if (const tinyxml2::XMLText* textNode = node->ToText()) {
-            text += textNode->Value();
+            *text += textNode->Value();
         }
         node = node->NextSibling();
     }
-    return text;
 }
 
 void ParseLinksFromText(const tinyxml2::XMLElement* element, std::vector<std::string>& links) {
@@ -101,13 +96,21 @@ void TDocument::FromHtml(
     bool shrinkText,
     size_t maxWords)
 {
-    if (!boost::filesystem::exists(fileName)) {
-        throw std::runtime_error("No HTML file");
-    }
-    tinyxml2::XMLDocument originalDoc;
-    originalDoc.LoadFile(fileName);
+    // Throws if there is no such file
+    const TMappedFile html(fileName);
+    FromHtmlBuffer(html.Data(), html.Size(), fileName, parseLinks, shrinkText, maxWords);
+}
 
-    FromHtml(originalDoc, fileName, parseLinks, shrinkText, maxWords);
+void TDocument::FromHtmlBuffer(
+    const char* data,
+    size_t size,
+    const std::string& fileName,
+    bool parseLinks,
+    bool shrinkText,
+    size_t maxWords)
+{
+    FileName = fileName;
+    THtmlExtractor(parseLinks, shrinkText, maxWords).Extract(data, size, this);
 }
 
 void TDocument::FromHtml(
@@ -168,15 +171,12 @@ void TDocument::FromHtml(
         std::vector<std::string> links;
         size_t wordCount = 0;
         while (pElement && (!shrinkText || wordCount < maxWords)) {
-            std::string pText = GetFullText(pElement);
+            const size_t pBegin = Text.size();
+            AppendFullText(pElement, &Text);
             if (shrinkText) {
-                std::istringstream iss(pText);
-                std::string word;
-                while (iss >> word) {
-                    wordCount++;
-                }
+                wordCount += CountWords(std::string_view(Text).substr(pBegin));
             }
-            Text += pText + "\n";
+            Text += "\n";
             if (parseLinks) {
                 ParseLinksFromText(pElement, links);
             }
@@ -193,7 +193,7 @@ void TDocument::FromHtml(
         PubTime = DateToTimestamp(timeElement->Attribute("datetime"));
     }
     const tinyxml2::XMLElement* aElement = addressElement->FirstChildElement("a");
-    if (aElement && aElement->Attribute("rel") && std::string(aElement->Attribute("rel")) == "author") {
+    if (aElement && aElement->Attribute("rel") && std::string(aElement->Attribute("rel")) == "author" && aElement->GetText()) {
         Author = aElement->GetText();
     }
 }
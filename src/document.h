@@ -41,6 +41,15 @@ public:
         bool shrinkText=false,
         size_t maxWords=200
     );
+    // Same fields as FromHtml with a tinyxml2 DOM of the data, but parsed in one pass
+    void FromHtmlBuffer(
+        const char* data,
+        size_t size,
+        const std::string& fileName,
+        bool parseLinks=false,
+        bool shrinkText=false,
+        size_t maxWords=200
+    );
     void FromHtml(
         const tinyxml2::XMLDocument& html,
         const std::string& fileName,
@@ -0,0 +1,121 @@
+#include "document_archive.h"
+#include "util.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <optional>
+
+namespace {
+
+constexpr char ARCHIVE_MAGIC[8] = {'T', 'G', 'A', 'R', 'C', 'H', '\0', '\0'};
+constexpr uint32_t ARCHIVE_VERSION = 1;
+
+struct TArchiveHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t Reserved;
+    uint64_t DocsCount;
+    uint64_t EntriesOffset;
+    uint64_t FileSize;
+};
+
+} // namespace
+
+size_t TDocumentArchive::Pack(const std::string& path, const std::vector<std::string>& fileNames) {
+    std::vector<TEntry> entries;
+    entries.reserve(fileNames.size());
+
+    WriteFileAtomically(path, [&](std::ofstream& stream) {
+        TArchiveHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.Magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        header.Version = ARCHIVE_VERSION;
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        uint64_t position = sizeof(header);
+        for (const std::string& fileName : fileNames) {
+            std::optional<TMappedFile> file;
+            try {
+                file.emplace(fileName);
+            } catch (...) {
+                LOG_DEBUG("Bad html: " << fileName);
+                continue;
+            }
+            stream.write(fileName.data(), fileName.size());
+            stream.write(file->Data(), file->Size());
+            entries.push_back({position, fileName.size(), file->Size()});
+            position += fileName.size() + file->Size();
+        }
+
+        // The entry table is aligned to be read in place
+        static const char padding[alignof(TEntry)] = {};
+        const uint64_t paddingSize = (alignof(TEntry) - position % alignof(TEntry)) % alignof(TEntry);
+        stream.write(padding, paddingSize);
+        position += paddingSize;
+
+        header.DocsCount = entries.size();
+        header.EntriesOffset = position;
+        stream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(TEntry));
+        header.FileSize = position + entries.size() * sizeof(TEntry);
+
+        stream.seekp(0);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    });
+    return entries.size();
+}
+
+TDocumentArchive::TDocumentArchive(const std::string& path)
+    : File(path)
+{
+    ENSURE(File.Size() >= sizeof(TArchiveHeader), "Bad archive " << path << ": too small");
+    const auto* header = reinterpret_cast<const TArchiveHeader*>(File.Data());
+    ENSURE(std::memcmp(header->Magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0, "Bad archive " << path << ": wrong magic");
+    ENSURE(header->Version == ARCHIVE_VERSION, "Bad archive " << path << ": unsupported version " << header->Version);
+    ENSURE(header->FileSize == File.Size(), "Bad archive " << path << ": truncated");
+    ENSURE(header->EntriesOffset <= File.Size()
+        && header->DocsCount <= (File.Size() - header->EntriesOffset) / sizeof(TEntry),
+        "Bad archive " << path << ": wrong entry table");
+    // Documents are checked once here, so the getters do not check bounds.
+    // They go in the entry order without overlaps, Prefetch relies on it.
+    uint64_t previousEnd = sizeof(TArchiveHeader);
+    for (size_t i = 0; i < Size(); ++i) {
+        const TEntry& entry = GetEntry(i);
+        ENSURE(entry.Offset >= previousEnd
+            && entry.Offset <= header->EntriesOffset
+            && entry.NameSize <= header->EntriesOffset - entry.Offset
+            && entry.DataSize <= header->EntriesOffset - entry.Offset - entry.NameSize,
+            "Bad archive " << path << ": wrong document offset");
+        previousEnd = entry.Offset + entry.NameSize + entry.DataSize;
+    }
+}
+
+size_t TDocumentArchive::Size() const {
+    return reinterpret_cast<const TArchiveHeader*>(File.Data())->DocsCount;
+}
+
+const TDocumentArchive::TEntry& TDocumentArchive::GetEntry(size_t index) const {
+    assert(index < Size());
+    const auto* header = reinterpret_cast<const TArchiveHeader*>(File.Data());
+    return reinterpret_cast<const TEntry*>(File.Data() + header->EntriesOffset)[index];
+}
+
+std::string_view TDocumentArchive::GetName(size_t index) const {
+    const TEntry& entry = GetEntry(index);
+    return std::string_view(File.Data() + entry.Offset, entry.NameSize);
+}
+
+std::string_view TDocumentArchive::GetData(size_t index) const {
+    const TEntry& entry = GetEntry(index);
+    return std::string_view(File.Data() + entry.Offset + entry.NameSize, entry.DataSize);
+}
+
+void TDocumentArchive::Prefetch(size_t begin, size_t end) const {
+    if (begin >= end) {
+        return;
+    }
+    // Documents are stored in the entry order, it is checked in the constructor
+    const TEntry& first = GetEntry(begin);
+    const TEntry& last = GetEntry(end - 1);
+    File.Prefetch(first.Offset, last.Offset + last.NameSize + last.DataSize - first.Offset);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Many html files concatenated into one file, read through mmap.
+// Opening the archive costs one open and one mmap instead of an open and a stat per document.
+//
+// Layout: header, then a name and the contents of every file, then the entry table with their offsets
+class TDocumentArchive {
+public:
+    explicit TDocumentArchive(const std::string& path);
+
+    // Unreadable files are skipped. Returns the number of packed files.
+    static size_t Pack(const std::string& path, const std::vector<std::string>& fileNames);
+
+    size_t Size() const;
+    std::string_view GetName(size_t index) const;
+    std::string_view GetData(size_t index) const;
+
+    // Starts reading documents [begin, end) into the page cache in the background
+    void Prefetch(size_t begin, size_t end) const;
+
+private:
+    struct TEntry {
+        uint64_t Offset;
+        uint64_t NameSize;
+        uint64_t DataSize;
+    };
+
+    const TEntry& GetEntry(size_t index) const;
+
+private:
+    TMappedFile File;
+};
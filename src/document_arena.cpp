@@ -0,0 +1,85 @@
+#include "document_arena.h"
+#include "host_interner.h"
+#include "util.h"
+
+#include <cmath>
+#include <cstring>
+
+TEmbeddingMatrix::TEmbeddingMatrix(size_t rows, size_t cols)
+    : Rows(rows)
+    , Cols(cols)
+    , BadRows(rows, false)
+{
+    size_t bytes = std::max(rows * cols * sizeof(float), ALIGNMENT);
+    bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    Data.reset(static_cast<float*>(std::aligned_alloc(ALIGNMENT, bytes)));
+    ENSURE(Data, "Could not allocate embedding matrix");
+    std::memset(Data.get(), 0, bytes);
+}
+
+void TEmbeddingMatrix::SetRow(size_t index, const std::vector<float>& embedding) {
+    assert(index < Rows);
+    ENSURE(embedding.size() == Cols, "Embedding size mismatch: " << embedding.size() << " vs " << Cols);
+    Eigen::Map<const Eigen::VectorXf, Eigen::Unaligned> docVector(embedding.data(), embedding.size());
+    Eigen::Map<Eigen::VectorXf, Eigen::Unaligned> row(Data.get() + index * Cols, Cols);
+    const float norm = docVector.norm();
+    if (std::abs(norm - 0.0) > 0.00000001) {
+        row = docVector / norm;
+    } else {
+        BadRows[index] = true;
+    }
+}
+
+TDocumentArena::TDocumentArena(std::vector<TDbDocumentPtr> docs)
+    : Documents(std::move(docs))
+{
+    Init();
+}
+
+TDocumentArena::TDocumentArena(std::vector<TDbDocument>&& docs) {
+    std::vector<std::shared_ptr<TDbDocument>> ownDocs;
+    ownDocs.reserve(docs.size());
+    for (TDbDocument& doc : docs) {
+        ownDocs.push_back(std::make_shared<TDbDocument>(std::move(doc)));
+    }
+    docs.clear();
+    Documents.assign(ownDocs.begin(), ownDocs.end());
+    Init();
+    // Nobody else has these documents, so the copies in them are not needed anymore
+    for (const auto& doc : ownDocs) {
+        decltype(doc->Embeddings)().swap(doc->Embeddings);
+    }
+}
+
+void TDocumentArena::Init() {
+    assert(Documents.size() <= std::numeric_limits<uint32_t>::max());
+    std::unordered_map<tg::EEmbeddingKey, size_t> keysSizes;
+    for (const TDbDocumentPtr& doc : Documents) {
+        for (const auto& [key, embedding] : doc->Embeddings) {
+            keysSizes.try_emplace(key, embedding.size());
+        }
+    }
+    for (const auto& [key, size] : keysSizes) {
+        TEmbeddingMatrix matrix(Documents.size(), size);
+        for (size_t i = 0; i < Documents.size(); ++i) {
+            auto it = Documents[i]->Embeddings.find(key);
+            if (it != Documents[i]->Embeddings.end()) {
+                matrix.SetRow(i, it->second);
+            } else {
+                matrix.SetRow(i, std::vector<float>(size, 0.0f));
+            }
+        }
+        Embeddings.emplace(key, std::move(matrix));
+    }
+
+    HostIds.reserve(Documents.size());
+    for (const TDbDocumentPtr& doc : Documents) {
+        HostIds.push_back(THostInterner::Instance().Intern(doc->Host));
+    }
+}
+
+const TEmbeddingMatrix& TDocumentArena::GetEmbeddings(tg::EEmbeddingKey key) const {
+    auto it = Embeddings.find(key);
+    ENSURE(it != Embeddings.end(), "No embeddings for key " << tg::EEmbeddingKey_Name(key));
+    return it->second;
+}
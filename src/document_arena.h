@@ -0,0 +1,71 @@
+#pragma once
+
+#include "db_document.h"
+
+#include <Eigen/Core>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Contiguous 64-byte aligned matrix of L2-normalized embeddings, one row per document
+class TEmbeddingMatrix {
+public:
+    using TRowMajorMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    using TConstMap = Eigen::Map<const TRowMajorMatrix, Eigen::Aligned64>;
+
+    static constexpr size_t ALIGNMENT = 64;
+
+    TEmbeddingMatrix(size_t rows, size_t cols);
+
+    // Zero vectors can not be normalized, their rows are left empty and marked as bad
+    void SetRow(size_t index, const std::vector<float>& embedding);
+
+    TConstMap GetMatrix() const { return TConstMap(Data.get(), Rows, Cols); }
+    bool IsBadRow(size_t index) const { return BadRows[index]; }
+    size_t GetRows() const { return Rows; }
+    size_t GetCols() const { return Cols; }
+
+private:
+    struct TFreeDeleter {
+        void operator()(float* ptr) const { std::free(ptr); }
+    };
+
+    size_t Rows = 0;
+    size_t Cols = 0;
+    std::unique_ptr<float[], TFreeDeleter> Data;
+    std::vector<bool> BadRows;
+};
+
+// Immutable storage of the documents, clusters refer to them by indices.
+// Embeddings are gathered from the documents into per key matrices, use GetEmbeddings to read them.
+class TDocumentArena {
+public:
+    // Shared documents are not changed, their embeddings are copied
+    explicit TDocumentArena(std::vector<TDbDocumentPtr> docs);
+    // Takes the documents over and moves their embeddings out,
+    // TDbDocument::Embeddings of the stored documents are empty
+    explicit TDocumentArena(std::vector<TDbDocument>&& docs);
+
+    const std::vector<TDbDocumentPtr>& GetDocuments() const { return Documents; }
+    const TDbDocument& operator[](uint32_t index) const { return *Documents[index]; }
+    size_t Size() const { return Documents.size(); }
+    // Host ids are from THostInterner
+    uint32_t GetHostId(uint32_t index) const { return HostIds[index]; }
+
+    const TEmbeddingMatrix& GetEmbeddings(tg::EEmbeddingKey key) const;
+
+private:
+    void Init();
+
+private:
+    std::vector<TDbDocumentPtr> Documents;
+    std::vector<uint32_t> HostIds;
+    std::unordered_map<tg::EEmbeddingKey, TEmbeddingMatrix> Embeddings;
+};
+
+using TDocumentArenaPtr = std::shared_ptr<const TDocumentArena>;
@@ -0,0 +1,89 @@
+#include "document_cache.h"
+
+#include <functional>
+
+TDocumentCache::TDocumentCache(size_t shardsCount) {
+    shardsCount = std::max(shardsCount, static_cast<size_t>(1));
+    Shards.reserve(shardsCount);
+    for (size_t i = 0; i < shardsCount; ++i) {
+        Shards.push_back(std::make_unique<TShard>());
+    }
+}
+
+bool TDocumentCache::Put(TDbDocument document, uint64_t valueHash, const TUpdateCallback& onUpdate) {
+    TDbDocumentPtr sharedDocument = std::make_shared<const TDbDocument>(std::move(document));
+    const std::string fileName = sharedDocument->FileName;
+    TShard& shard = GetShard(fileName);
+    {
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        if (onUpdate && !onUpdate()) {
+            return false;
+        }
+        shard.Entries[fileName] = TEntry{std::move(sharedDocument), valueHash};
+    }
+    Version.fetch_add(1, std::memory_order_acq_rel);
+    return true;
+}
+
+bool TDocumentCache::Delete(const std::string& fileName, const TUpdateCallback& onUpdate) {
+    return DeleteImpl(fileName, nullptr, onUpdate);
+}
+
+bool TDocumentCache::DeleteIf(const TDbDocumentPtr& document, const TUpdateCallback& onUpdate) {
+    return DeleteImpl(document->FileName, document.get(), onUpdate);
+}
+
+bool TDocumentCache::DeleteImpl(const std::string& fileName, const TDbDocument* expected, const TUpdateCallback& onUpdate) {
+    TShard& shard = GetShard(fileName);
+    {
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        auto it = shard.Entries.find(fileName);
+        if (it == shard.Entries.end() || (expected && it->second.Document.get() != expected)) {
+            return false;
+        }
+        if (onUpdate && !onUpdate()) {
+            return false;
+        }
+        shard.Entries.erase(it);
+    }
+    Version.fetch_add(1, std::memory_order_acq_rel);
+    return true;
+}
+
+bool TDocumentCache::Contains(const std::string& fileName) const {
+    const TShard& shard = GetShard(fileName);
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    return shard.Entries.find(fileName) != shard.Entries.end();
+}
+
+std::vector<TDbDocumentPtr> TDocumentCache::GetDocuments(TValueHashes* valueHashes) const {
+    std::vector<TDbDocumentPtr> documents;
+    documents.reserve(Size());
+    for (const auto& shard : Shards) {
+        std::lock_guard<std::mutex> lock(shard->Mutex);
+        for (const auto& [fileName, entry] : shard->Entries) {
+            documents.push_back(entry.Document);
+            if (valueHashes) {
+                (*valueHashes)[fileName] = entry.ValueHash;
+            }
+        }
+    }
+    return documents;
+}
+
+size_t TDocumentCache::Size() const {
+    size_t size = 0;
+    for (const auto& shard : Shards) {
+        std::lock_guard<std::mutex> lock(shard->Mutex);
+        size += shard->Entries.size();
+    }
+    return size;
+}
+
+TDocumentCache::TShard& TDocumentCache::GetShard(const std::string& fileName) {
+    return *Shards[std::hash<std::string>()(fileName) % Shards.size()];
+}
+
+const TDocumentCache::TShard& TDocumentCache::GetShard(const std::string& fileName) const {
+    return *Shards[std::hash<std::string>()(fileName) % Shards.size()];
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "db_document.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Resident copy of the indexed documents keyed by file name, sharded to keep handlers from contending.
+// The database is only read at startup to fill it.
+class TDocumentCache {
+public:
+    using TValueHashes = std::unordered_map<std::string, uint64_t>;
+    // Called under the lock of the file name, so the database is changed in the same order as the cache.
+    // The cache is not changed if it returns false.
+    using TUpdateCallback = std::function<bool()>;
+
+    explicit TDocumentCache(size_t shardsCount = 16);
+
+    // Value hash is a hash of the serialized document in the database, see TDocumentSnapshot
+    bool Put(TDbDocument document, uint64_t valueHash = 0, const TUpdateCallback& onUpdate = {});
+    bool Delete(const std::string& fileName, const TUpdateCallback& onUpdate = {});
+    // Deletes the document only if it was not replaced since it was read from the cache
+    bool DeleteIf(const TDbDocumentPtr& document, const TUpdateCallback& onUpdate = {});
+    bool Contains(const std::string& fileName) const;
+
+    // Documents are shared with the cache, they are never changed in place
+    std::vector<TDbDocumentPtr> GetDocuments(TValueHashes* valueHashes = nullptr) const;
+    size_t Size() const;
+
+    // Incremented on every change
+    uint64_t GetVersion() const { return Version.load(std::memory_order_acquire); }
+
+private:
+    struct TEntry {
+        TDbDocumentPtr Document;
+        uint64_t ValueHash = 0;
+    };
+
+    struct TShard {
+        mutable std::mutex Mutex;
+        std::unordered_map<std::string, TEntry> Entries;
+    };
+
+    bool DeleteImpl(const std::string& fileName, const TDbDocument* expected, const TUpdateCallback& onUpdate);
+    TShard& GetShard(const std::string& fileName);
+    const TShard& GetShard(const std::string& fileName) const;
+
+private:
+    std::vector<std::unique_ptr<TShard>> Shards;
+    std::atomic<uint64_t> Version {0};
+};
@@ -0,0 +1,367 @@
+#include "document_snapshot.h"
+#include "util.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'T', 'G', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+constexpr size_t SECTION_ALIGNMENT = 64;
+
+// Value hashes outlive the process, so the function is fixed and recorded in the header
+enum EValueHashType : uint32_t {
+    VH_FNV1A_64 = 1
+};
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+enum ESnapshotSection : size_t {
+    SS_FETCH_TIME = 0,
+    SS_PUB_TIME,
+    SS_TTL,
+    SS_LANGUAGE,
+    SS_CATEGORY,
+    SS_NASTY,
+    SS_VALUE_HASH,
+    SS_FILE_NAME,
+    SS_URL,
+    SS_TITLE,
+    SS_HOST,
+    SS_SITE_NAME,
+    SS_STRING_OFFSETS,
+    SS_STRING_DATA,
+    SS_EMBEDDING_KEYS,
+    SS_COUNT
+};
+
+struct TSnapshotHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t DocsCount;
+    uint32_t StringsCount;
+    uint32_t EmbeddingKeysCount;
+    uint32_t ValueHashType;
+    uint32_t Reserved;
+    uint64_t FileSize;
+    uint64_t SectionOffsets[SS_COUNT];
+};
+
+struct TEmbeddingBlockHeader {
+    int32_t Key;
+    uint32_t Dimension;
+    uint64_t ValuesOffset;
+    uint64_t PresenceOffset;
+};
+
+class TStringInterner {
+public:
+    uint32_t Intern(const std::string& value) {
+        auto [it, inserted] = Ids.try_emplace(value, static_cast<uint32_t>(Offsets.size() - 1));
+        if (inserted) {
+            Data.append(value);
+            Offsets.push_back(Data.size());
+        }
+        return it->second;
+    }
+
+    const std::vector<uint64_t>& GetOffsets() const { return Offsets; }
+    const std::string& GetData() const { return Data; }
+
+private:
+    std::unordered_map<std::string, uint32_t> Ids;
+    std::vector<uint64_t> Offsets = {0};
+    std::string Data;
+};
+
+class TSectionWriter {
+public:
+    explicit TSectionWriter(std::ofstream& stream) : Stream(stream) {}
+
+    uint64_t Write(const void* data, size_t size) {
+        const uint64_t offset = Align();
+        Stream.write(static_cast<const char*>(data), size);
+        Position += size;
+        return offset;
+    }
+
+    template <typename T>
+    uint64_t Write(const std::vector<T>& column) {
+        return Write(column.data(), column.size() * sizeof(T));
+    }
+
+    uint64_t GetPosition() const { return Position; }
+    void SetPosition(uint64_t position) { Position = position; }
+
+private:
+    uint64_t Align() {
+        static const char padding[SECTION_ALIGNMENT] = {};
+        const uint64_t aligned = (Position + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        Stream.write(padding, aligned - Position);
+        Position = aligned;
+        return Position;
+    }
+
+private:
+    std::ofstream& Stream;
+    uint64_t Position = 0;
+};
+
+const TDbDocument& GetDocument(const TDbDocument& doc) {
+    return doc;
+}
+
+const TDbDocument& GetDocument(const TDbDocumentPtr& doc) {
+    return *doc;
+}
+
+template <typename TDocument>
+void WriteSnapshot(
+    const std::string& path,
+    const std::vector<TDocument>& docs,
+    const std::unordered_map<std::string, uint64_t>& valueHashes)
+{
+    const size_t docsCount = docs.size();
+    std::vector<uint64_t> fetchTimes(docsCount);
+    std::vector<uint64_t> pubTimes(docsCount);
+    std::vector<uint64_t> ttls(docsCount);
+    std::vector<int32_t> languages(docsCount);
+    std::vector<int32_t> categories(docsCount);
+    std::vector<uint8_t> nasty(docsCount);
+    std::vector<uint64_t> hashes(docsCount);
+    std::vector<uint32_t> fileNames(docsCount);
+    std::vector<uint32_t> urls(docsCount);
+    std::vector<uint32_t> titles(docsCount);
+    std::vector<uint32_t> hosts(docsCount);
+    std::vector<uint32_t> siteNames(docsCount);
+    std::map<tg::EEmbeddingKey, uint32_t> embeddingDimensions;
+    TStringInterner strings;
+    for (size_t i = 0; i < docsCount; ++i) {
+        const TDbDocument& doc = GetDocument(docs[i]);
+        fetchTimes[i] = doc.FetchTime;
+        pubTimes[i] = doc.PubTime;
+        ttls[i] = doc.Ttl;
+        languages[i] = static_cast<int32_t>(doc.Language);
+        categories[i] = static_cast<int32_t>(doc.Category);
+        nasty[i] = doc.Nasty ? 1 : 0;
+        auto hashIt = valueHashes.find(doc.FileName);
+        hashes[i] = hashIt != valueHashes.end() ? hashIt->second : 0;
+        fileNames[i] = strings.Intern(doc.FileName);
+        urls[i] = strings.Intern(doc.Url);
+        titles[i] = strings.Intern(doc.Title);
+        hosts[i] = strings.Intern(doc.Host);
+        siteNames[i] = strings.Intern(doc.SiteName);
+        for (const auto& [key, embedding] : doc.Embeddings) {
+            embeddingDimensions.try_emplace(key, static_cast<uint32_t>(embedding.size()));
+        }
+    }
+
+    WriteFileAtomically(path, [&](std::ofstream& stream) {
+        TSnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.Magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.Version = SNAPSHOT_VERSION;
+        header.DocsCount = static_cast<uint32_t>(docsCount);
+        header.StringsCount = static_cast<uint32_t>(strings.GetOffsets().size() - 1);
+        header.EmbeddingKeysCount = static_cast<uint32_t>(embeddingDimensions.size());
+        header.ValueHashType = VH_FNV1A_64;
+
+        TSectionWriter writer(stream);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writer.SetPosition(sizeof(header));
+
+        header.SectionOffsets[SS_FETCH_TIME] = writer.Write(fetchTimes);
+        header.SectionOffsets[SS_PUB_TIME] = writer.Write(pubTimes);
+        header.SectionOffsets[SS_TTL] = writer.Write(ttls);
+        header.SectionOffsets[SS_LANGUAGE] = writer.Write(languages);
+        header.SectionOffsets[SS_CATEGORY] = writer.Write(categories);
+        header.SectionOffsets[SS_NASTY] = writer.Write(nasty);
+        header.SectionOffsets[SS_VALUE_HASH] = writer.Write(hashes);
+        header.SectionOffsets[SS_FILE_NAME] = writer.Write(fileNames);
+        header.SectionOffsets[SS_URL] = writer.Write(urls);
+        header.SectionOffsets[SS_TITLE] = writer.Write(titles);
+        header.SectionOffsets[SS_HOST] = writer.Write(hosts);
+        header.SectionOffsets[SS_SITE_NAME] = writer.Write(siteNames);
+        header.SectionOffsets[SS_STRING_OFFSETS] = writer.Write(strings.GetOffsets());
+        header.SectionOffsets[SS_STRING_DATA] = writer.Write(strings.GetData().data(), strings.GetData().size());
+
+        std::vector<TEmbeddingBlockHeader> blocks;
+        for (const auto& [key, dimension] : embeddingDimensions) {
+            std::vector<float> values(docsCount * dimension, 0.0f);
+            std::vector<uint8_t> presence(docsCount, 0);
+            for (size_t i = 0; i < docsCount; ++i) {
+                const TDbDocument& doc = GetDocument(docs[i]);
+                auto it = doc.Embeddings.find(key);
+                if (it == doc.Embeddings.end()) {
+                    continue;
+                }
+                ENSURE(it->second.size() == dimension, "Embedding size mismatch in " << doc.FileName);
+                std::copy(it->second.begin(), it->second.end(), values.begin() + i * dimension);
+                presence[i] = 1;
+            }
+            TEmbeddingBlockHeader block;
+            block.Key = static_cast<int32_t>(key);
+            block.Dimension = dimension;
+            block.ValuesOffset = writer.Write(values);
+            block.PresenceOffset = writer.Write(presence);
+            blocks.push_back(block);
+        }
+        header.SectionOffsets[SS_EMBEDDING_KEYS] = writer.Write(blocks);
+        header.FileSize = writer.GetPosition();
+
+        stream.seekp(0);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    });
+}
+
+} // namespace
+
+void TDocumentSnapshot::Write(
+    const std::string& path,
+    const std::vector<TDbDocument>& docs,
+    const std::unordered_map<std::string, uint64_t>& valueHashes)
+{
+    WriteSnapshot(path, docs, valueHashes);
+}
+
+void TDocumentSnapshot::Write(
+    const std::string& path,
+    const std::vector<TDbDocumentPtr>& docs,
+    const std::unordered_map<std::string, uint64_t>& valueHashes)
+{
+    WriteSnapshot(path, docs, valueHashes);
+}
+
+TDocumentSnapshot::TDocumentSnapshot(const std::string& path)
+    : File(path)
+{
+    ENSURE(File.Size() >= sizeof(TSnapshotHeader), "Bad snapshot " << path << ": too small");
+    const auto* header = reinterpret_cast<const TSnapshotHeader*>(File.Data());
+    ENSURE(std::memcmp(header->Magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0, "Bad snapshot " << path << ": wrong magic");
+    ENSURE(header->Version == SNAPSHOT_VERSION, "Bad snapshot " << path << ": unsupported version " << header->Version);
+    ENSURE(header->ValueHashType == VH_FNV1A_64, "Bad snapshot " << path << ": unsupported value hash " << header->ValueHashType);
+    ENSURE(header->FileSize == File.Size(), "Bad snapshot " << path << ": truncated");
+
+    // Sections are checked once here, so the getters do not check bounds
+    const auto isInFile = [this] (uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t alignment) {
+        return offset % alignment == 0 && offset <= File.Size() && count <= (File.Size() - offset) / itemSize;
+    };
+    const uint64_t docsCount = header->DocsCount;
+    const uint64_t* offsets = header->SectionOffsets;
+    ENSURE(isInFile(offsets[SS_FETCH_TIME], docsCount, sizeof(uint64_t), alignof(uint64_t))
+        && isInFile(offsets[SS_PUB_TIME], docsCount, sizeof(uint64_t), alignof(uint64_t))
+        && isInFile(offsets[SS_TTL], docsCount, sizeof(uint64_t), alignof(uint64_t))
+        && isInFile(offsets[SS_LANGUAGE], docsCount, sizeof(int32_t), alignof(int32_t))
+        && isInFile(offsets[SS_CATEGORY], docsCount, sizeof(int32_t), alignof(int32_t))
+        && isInFile(offsets[SS_NASTY], docsCount, sizeof(uint8_t), alignof(uint8_t))
+        && isInFile(offsets[SS_VALUE_HASH], docsCount, sizeof(uint64_t), alignof(uint64_t))
+        && isInFile(offsets[SS_STRING_OFFSETS], header->StringsCount + 1ULL, sizeof(uint64_t), alignof(uint64_t))
+        && isInFile(offsets[SS_EMBEDDING_KEYS], header->EmbeddingKeysCount, sizeof(TEmbeddingBlockHeader), alignof(TEmbeddingBlockHeader)),
+        "Bad snapshot " << path << ": wrong section offset");
+
+    const uint64_t* stringOffsets = GetColumn<uint64_t>(SS_STRING_OFFSETS);
+    ENSURE(stringOffsets[0] == 0 && isInFile(offsets[SS_STRING_DATA], stringOffsets[header->StringsCount], 1, 1),
+        "Bad snapshot " << path << ": wrong string data");
+    for (size_t i = 0; i < header->StringsCount; ++i) {
+        ENSURE(stringOffsets[i] <= stringOffsets[i + 1], "Bad snapshot " << path << ": wrong string offset");
+    }
+    for (size_t section : {SS_FILE_NAME, SS_URL, SS_TITLE, SS_HOST, SS_SITE_NAME}) {
+        ENSURE(isInFile(offsets[section], docsCount, sizeof(uint32_t), alignof(uint32_t)), "Bad snapshot " << path << ": wrong section offset");
+        const uint32_t* ids = GetColumn<uint32_t>(section);
+        for (size_t i = 0; i < docsCount; ++i) {
+            ENSURE(ids[i] < header->StringsCount, "Bad snapshot " << path << ": wrong string id");
+        }
+    }
+
+    const auto* blocks = GetColumn<TEmbeddingBlockHeader>(SS_EMBEDDING_KEYS);
+    for (size_t i = 0; i < header->EmbeddingKeysCount; ++i) {
+        const TEmbeddingBlockHeader& block = blocks[i];
+        ENSURE(block.Dimension != 0
+            && docsCount <= std::numeric_limits<uint64_t>::max() / block.Dimension
+            && isInFile(block.ValuesOffset, docsCount * block.Dimension, sizeof(float), alignof(float))
+            && isInFile(block.PresenceOffset, docsCount, sizeof(uint8_t), alignof(uint8_t)),
+            "Bad snapshot " << path << ": wrong embedding block");
+    }
+
+    FileNameToIndex.reserve(Size());
+    const uint32_t* fileNames = GetColumn<uint32_t>(SS_FILE_NAME);
+    for (size_t i = 0; i < Size(); ++i) {
+        FileNameToIndex.emplace(GetString(fileNames[i]), i);
+    }
+}
+
+template <typename T>
+const T* TDocumentSnapshot::GetColumn(size_t section) const {
+    const auto* header = reinterpret_cast<const TSnapshotHeader*>(File.Data());
+    return reinterpret_cast<const T*>(File.Data() + header->SectionOffsets[section]);
+}
+
+std::string_view TDocumentSnapshot::GetString(uint32_t id) const {
+    assert(id < reinterpret_cast<const TSnapshotHeader*>(File.Data())->StringsCount);
+    const uint64_t* offsets = GetColumn<uint64_t>(SS_STRING_OFFSETS);
+    const char* data = GetColumn<char>(SS_STRING_DATA);
+    return std::string_view(data + offsets[id], offsets[id + 1] - offsets[id]);
+}
+
+uint64_t TDocumentSnapshot::HashValue(std::string_view value) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const char c : value) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+size_t TDocumentSnapshot::Size() const {
+    return reinterpret_cast<const TSnapshotHeader*>(File.Data())->DocsCount;
+}
+
+TDbDocument TDocumentSnapshot::GetDocument(size_t index) const {
+    assert(index < Size());
+    const auto* header = reinterpret_cast<const TSnapshotHeader*>(File.Data());
+    TDbDocument doc;
+    doc.FetchTime = GetColumn<uint64_t>(SS_FETCH_TIME)[index];
+    doc.PubTime = GetColumn<uint64_t>(SS_PUB_TIME)[index];
+    doc.Ttl = GetColumn<uint64_t>(SS_TTL)[index];
+    doc.Language = static_cast<tg::ELanguage>(GetColumn<int32_t>(SS_LANGUAGE)[index]);
+    doc.Category = static_cast<tg::ECategory>(GetColumn<int32_t>(SS_CATEGORY)[index]);
+    doc.Nasty = GetColumn<uint8_t>(SS_NASTY)[index] != 0;
+    doc.FileName = GetString(GetColumn<uint32_t>(SS_FILE_NAME)[index]);
+    doc.Url = GetString(GetColumn<uint32_t>(SS_URL)[index]);
+    doc.Title = GetString(GetColumn<uint32_t>(SS_TITLE)[index]);
+    doc.Host = GetString(GetColumn<uint32_t>(SS_HOST)[index]);
+    doc.SiteName = GetString(GetColumn<uint32_t>(SS_SITE_NAME)[index]);
+
+    const auto* blocks = GetColumn<TEmbeddingBlockHeader>(SS_EMBEDDING_KEYS);
+    for (size_t blockIndex = 0; blockIndex < header->EmbeddingKeysCount; ++blockIndex) {
+        const TEmbeddingBlockHeader& block = blocks[blockIndex];
+        if (File.Data()[block.PresenceOffset + index] == 0) {
+            continue;
+        }
+        const float* values = reinterpret_cast<const float*>(File.Data() + block.ValuesOffset) + index * block.Dimension;
+        doc.Embeddings.emplace(static_cast<tg::EEmbeddingKey>(block.Key), TDbDocument::TEmbedding(values, values + block.Dimension));
+    }
+    return doc;
+}
+
+std::vector<TDbDocument> TDocumentSnapshot::GetDocuments() const {
+    std::vector<TDbDocument> docs;
+    docs.reserve(Size());
+    for (size_t i = 0; i < Size(); ++i) {
+        docs.push_back(GetDocument(i));
+    }
+    return docs;
+}
+
+std::optional<size_t> TDocumentSnapshot::Find(std::string_view fileName) const {
+    auto it = FileNameToIndex.find(fileName);
+    return it != FileNameToIndex.end() ? std::make_optional(it->second) : std::nullopt;
+}
+
+uint64_t TDocumentSnapshot::GetValueHash(size_t index) const {
+    return GetColumn<uint64_t>(SS_VALUE_HASH)[index];
+}
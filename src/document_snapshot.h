@@ -0,0 +1,53 @@
+#pragma once
+
+#include "db_document.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Columnar binary snapshot of the documents, read through mmap without parsing.
+// Only the fields used by clustering and ranking are stored: texts, descriptions and out-links are dropped.
+//
+// Layout: header with the value hash function, then 64-byte aligned sections
+//  - fixed width columns: fetch_time, pub_time, ttl, language, category, nasty, value hash
+//  - string id columns: file_name, url, title, host, site_name
+//  - interned strings: offsets and a blob
+//  - embedding blocks: for every key a dense docs x dim float matrix and a presence column
+class TDocumentSnapshot {
+public:
+    explicit TDocumentSnapshot(const std::string& path);
+
+    // Value hashes are used by the server to find out if the stored document is still up to date, zero means unknown
+    static void Write(
+        const std::string& path,
+        const std::vector<TDbDocument>& docs,
+        const std::unordered_map<std::string, uint64_t>& valueHashes = {});
+    static void Write(
+        const std::string& path,
+        const std::vector<TDbDocumentPtr>& docs,
+        const std::unordered_map<std::string, uint64_t>& valueHashes = {});
+
+    // 64-bit FNV-1a of the serialized document, the same function is used for all value hashes
+    static uint64_t HashValue(std::string_view value);
+
+    size_t Size() const;
+    TDbDocument GetDocument(size_t index) const;
+    std::vector<TDbDocument> GetDocuments() const;
+
+    std::optional<size_t> Find(std::string_view fileName) const;
+    uint64_t GetValueHash(size_t index) const;
+
+private:
+    template <typename T>
+    const T* GetColumn(size_t section) const;
+    std::string_view GetString(uint32_t id) const;
+
+private:
+    TMappedFile File;
+    std::unordered_map<std::string_view, size_t> FileNameToIndex;
+};
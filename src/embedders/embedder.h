@@ -2,6 +2,17 @@
 
 #include "config.pb.h"
 #include "enum.pb.h"
+#include "../token_stream.h"
+
+#include <vector>
+
+class TWordVectorCache;
+
+// Tokens of the embedded fields and the word vectors cache of their document
+struct TEmbedderInput {
+    TTokenSpan Tokens;
+    TWordVectorCache* WordVectors = nullptr;
+};
 
 class TEmbedder {
 public:
@@ -9,18 +20,28 @@ public:
 
     virtual ~TEmbedder() = default;
 
-    virtual std::vector<float> CalcEmbedding(const std::string& input) const = 0;
+    virtual std::vector<float> CalcEmbedding(const TEmbedderInput& input) const = 0;
+
+    // Embedders with models should override it to run one forward pass per batch
+    virtual std::vector<std::vector<float>> CalcEmbeddings(const std::vector<TEmbedderInput>& inputs) const {
+        std::vector<std::vector<float>> embeddings;
+        embeddings.reserve(inputs.size());
+        for (const TEmbedderInput& input : inputs) {
+            embeddings.push_back(CalcEmbedding(input));
+        }
+        return embeddings;
+    }
 
-    std::vector<float> CalcEmbedding(const std::string& title, const std::string& text) const {
-        std::string input;
-        if (Field == tg::EF_ALL) {
-            input = title + " " + text;
-        } else if (Field == tg::EF_TITLE) {
-            input = title;
+    // Tokens of the title are the first field of the stream, tokens of the text are the second one
+    TEmbedderInput MakeInput(const TTokenStream& tokens, TWordVectorCache* wordVectors = nullptr) const {
+        if (Field == tg::EF_TITLE) {
+            return {tokens.GetFields(0, 1), wordVectors};
         } else if (Field == tg::EF_TEXT) {
-            input = text;
+            return {tokens.GetFields(1, 2), wordVectors};
+        } else if (Field == tg::EF_ALL) {
+            return {tokens.GetAll(), wordVectors};
         }
-        return CalcEmbedding(input);
+        return {TTokenSpan(tokens, 0, 0), wordVectors};
     }
 
 protected:
@@ -1,7 +1,8 @@
 #include "ft_embedder.h"
+#include "word_vector_cache.h"
 #include "../util.h"
 
-#include <sstream>
+#include <algorithm>
 #include <cassert>
 
 #include <onmt/Tokenizer.h>
@@ -12,14 +13,24 @@ TFastTextEmbedder::TFastTextEmbedder(
     , tg::EAggregationMode mode
     , size_t maxWords
     , const std::string& modelPath
+    , TFTVectorModelStorage* vectorModels
 )
     : TEmbedder(field)
     , Mode(mode)
     , MaxWords(maxWords)
 {
     assert(!vectorModelPath.empty());
-    VectorModel.loadModel(vectorModelPath);
-    LOG_DEBUG("FastText " << vectorModelPath << " vector model loaded");
+    if (vectorModels) {
+        VectorModel = (*vectorModels)[vectorModelPath];
+    }
+    if (!VectorModel) {
+        VectorModel = std::make_shared<fasttext::FastText>();
+        VectorModel->loadModel(vectorModelPath);
+        LOG_DEBUG("FastText " << vectorModelPath << " vector model loaded");
+        if (vectorModels) {
+            (*vectorModels)[vectorModelPath] = VectorModel;
+        }
+    }
 
     if (!modelPath.empty()) {
         Model = torch::jit::load(modelPath);
@@ -27,38 +38,51 @@ TFastTextEmbedder::TFastTextEmbedder(
     }
 }
 
-TFastTextEmbedder::TFastTextEmbedder(tg::TEmbedderConfig config) : TFastTextEmbedder(
+TFastTextEmbedder::TFastTextEmbedder(tg::TEmbedderConfig config, TFTVectorModelStorage* vectorModels) : TFastTextEmbedder(
     config.vector_model_path(),
     config.embedder_field(),
     config.aggregation_mode(),
     config.max_words() != 0 ? config.max_words() : 100,
-    config.model_path()
+    config.model_path(),
+    vectorModels
 ) {}
 
-std::vector<float> TFastTextEmbedder::CalcEmbedding(const std::string& input) const {
-    std::istringstream ss(input);
-    size_t vectorSize = VectorModel.getDimension();
-    fasttext::Vector wordVector(vectorSize);
-    fasttext::Vector avgVector(vectorSize);
-    fasttext::Vector maxVector(vectorSize);
-    fasttext::Vector minVector(vectorSize);
-    std::string word;
+void TFastTextEmbedder::Aggregate(
+    const TEmbedderInput& input,
+    fasttext::Vector& avgVector,
+    fasttext::Vector& maxVector,
+    fasttext::Vector& minVector) const
+{
+    // Word vectors of the document are shared with the other embedders of the same vector model
+    TWordVectorCache localWordVectors;
+    TWordVectorCache& wordVectors = input.WordVectors ? *input.WordVectors : localWordVectors;
+    const TTokenSpan& tokens = input.Tokens;
+    size_t vectorSize = VectorModel->getDimension();
+    avgVector.zero();
+    maxVector.zero();
+    minVector.zero();
     size_t count = 0;
-    while (ss >> word) {
+    for (size_t tokenIndex = 0; tokenIndex < tokens.Size(); tokenIndex++) {
         if (count > MaxWords) {
             break;
         }
-        VectorModel.getWordVector(wordVector, word);
-        float norm = wordVector.norm();
-        if (norm < 0.0001f) {
+        // Empty tokens of empty fields are not words
+        if (tokens[tokenIndex].empty()) {
+            continue;
+        }
+        const float* wordVector = wordVectors.Get(*VectorModel, tokens[tokenIndex]);
+        if (!wordVector) {
             continue;
         }
-        wordVector.mul(1.0f / norm);
 
-        avgVector.addVector(wordVector);
+        for (size_t i = 0; i < vectorSize; i++) {
+            avgVector[i] += wordVector[i];
+        }
         if (count == 0) {
-            maxVector = wordVector;
-            minVector = wordVector;
+            for (size_t i = 0; i < vectorSize; i++) {
+                maxVector[i] = wordVector[i];
+                minVector[i] = wordVector[i];
+            }
         } else {
             for (size_t i = 0; i < vectorSize; i++) {
                 maxVector[i] = std::max(maxVector[i], wordVector[i]);
@@ -70,30 +94,58 @@ std::vector<float> TFastTextEmbedder::CalcEmbedding(const std::string& input) co
     if (count > 0) {
         avgVector.mul(1.0f / static_cast<float>(count));
     }
-    if (Mode == tg::AM_AVG) {
-        return std::vector<float>(avgVector.data(), avgVector.data() + avgVector.size());
-    } else if (Mode == tg::AM_MIN) {
-        return std::vector<float>(minVector.data(), minVector.data() + minVector.size());
-    } else if (Mode == tg::AM_MAX) {
-        return std::vector<float>(maxVector.data(), maxVector.data() + maxVector.size());
+}
+
+std::vector<float> TFastTextEmbedder::CalcEmbedding(const TEmbedderInput& input) const {
+    return CalcEmbeddings({input}).front();
+}
+
+std::vector<std::vector<float>> TFastTextEmbedder::CalcEmbeddings(const std::vector<TEmbedderInput>& inputs) const {
+    std::vector<std::vector<float>> resultVectors;
+    resultVectors.reserve(inputs.size());
+    if (inputs.empty()) {
+        return resultVectors;
+    }
+
+    size_t vectorSize = VectorModel->getDimension();
+    fasttext::Vector avgVector(vectorSize);
+    fasttext::Vector maxVector(vectorSize);
+    fasttext::Vector minVector(vectorSize);
+    if (Mode != tg::AM_MATRIX) {
+        for (const TEmbedderInput& input : inputs) {
+            Aggregate(input, avgVector, maxVector, minVector);
+            if (Mode == tg::AM_AVG) {
+                resultVectors.emplace_back(avgVector.data(), avgVector.data() + avgVector.size());
+            } else if (Mode == tg::AM_MIN) {
+                resultVectors.emplace_back(minVector.data(), minVector.data() + minVector.size());
+            } else if (Mode == tg::AM_MAX) {
+                resultVectors.emplace_back(maxVector.data(), maxVector.data() + maxVector.size());
+            }
+        }
+        return resultVectors;
     }
-    assert(Mode == tg::AM_MATRIX);
 
+    // All inputs go through the model in one [batchSize, 3 * dim] tensor
     int dim = static_cast<int>(vectorSize);
-    auto tensor = torch::zeros({dim * 3}, torch::requires_grad(false));
-    tensor.slice(0, 0, dim) = torch::from_blob(avgVector.data(), {dim});
-    tensor.slice(0, dim, 2 * dim) = torch::from_blob(maxVector.data(), {dim});
-    tensor.slice(0, 2 * dim, 3 * dim) = torch::from_blob(minVector.data(), {dim});
+    long batchSize = static_cast<long>(inputs.size());
+    auto tensor = torch::zeros({batchSize, dim * 3}, torch::requires_grad(false));
+    for (long i = 0; i < batchSize; i++) {
+        Aggregate(inputs[i], avgVector, maxVector, minVector);
+        auto row = tensor.select(0, i);
+        row.slice(0, 0, dim) = torch::from_blob(avgVector.data(), {dim});
+        row.slice(0, dim, 2 * dim) = torch::from_blob(maxVector.data(), {dim});
+        row.slice(0, 2 * dim, 3 * dim) = torch::from_blob(minVector.data(), {dim});
+    }
 
-    std::vector<torch::jit::IValue> inputs;
-    inputs.emplace_back(tensor.unsqueeze(0));
+    std::vector<torch::jit::IValue> modelInputs;
+    modelInputs.emplace_back(tensor);
 
-    at::Tensor outputTensor = Model.forward(inputs).toTensor().squeeze(0).contiguous();
-    float* outputTensorPtr = outputTensor.data_ptr<float>();
-    size_t outputDim = outputTensor.size(0);
-    std::vector<float> resultVector(outputDim);
-    for (size_t i = 0; i < outputDim; i++) {
-        resultVector[i] = outputTensorPtr[i];
+    at::Tensor outputTensor = Model.forward(modelInputs).toTensor().contiguous();
+    const float* outputTensorPtr = outputTensor.data_ptr<float>();
+    size_t outputDim = outputTensor.size(1);
+    for (long i = 0; i < batchSize; i++) {
+        const float* rowPtr = outputTensorPtr + i * outputDim;
+        resultVectors.emplace_back(rowPtr, rowPtr + outputDim);
     }
-    return resultVector;
+    return resultVectors;
 }
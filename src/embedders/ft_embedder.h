@@ -6,28 +6,45 @@
 #include <fasttext.h>
 #include <torch/script.h>
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+
 struct TDocument;
 
 namespace fasttext {
     class FastText;
 }
 
+// Vector models by path, embedders with the same vector_model_path share one model
+using TFTVectorModelStorage = std::unordered_map<std::string, std::shared_ptr<fasttext::FastText>>;
+
 class TFastTextEmbedder : public TEmbedder {
 public:
+    // Without the storage the vector model is not shared
     TFastTextEmbedder(
         const std::string& vectorModelPath,
         tg::EEmbedderField field,
         tg::EAggregationMode mode,
         size_t maxWords,
-        const std::string& modelPath);
+        const std::string& modelPath,
+        TFTVectorModelStorage* vectorModels = nullptr);
 
-    explicit TFastTextEmbedder(tg::TEmbedderConfig config);
+    explicit TFastTextEmbedder(tg::TEmbedderConfig config, TFTVectorModelStorage* vectorModels = nullptr);
 
-    std::vector<float> CalcEmbedding(const std::string& input) const override;
+    std::vector<float> CalcEmbedding(const TEmbedderInput& input) const override;
+    std::vector<std::vector<float>> CalcEmbeddings(const std::vector<TEmbedderInput>& inputs) const override;
+
+private:
+    void Aggregate(
+        const TEmbedderInput& input,
+        fasttext::Vector& avgVector,
+        fasttext::Vector& maxVector,
+        fasttext::Vector& minVector) const;
 
 private:
     tg::EAggregationMode Mode;
-    fasttext::FastText VectorModel;
+    std::shared_ptr<fasttext::FastText> VectorModel;
     size_t MaxWords;
     mutable torch::jit::script::Module Model;
 };
@@ -40,8 +40,8 @@ TTfIdfEmbedder::TTfIdfEmbedder(tg::TEmbedderConfig config) : TTfIdfEmbedder(
     config.model_path()
 ) {}
 
-std::vector<float> TTfIdfEmbedder::CalcEmbedding(const std::string& input) const {
-    std::vector<size_t> indices = TokenIndexer.Index(input);
+std::vector<float> TTfIdfEmbedder::CalcEmbedding(const TEmbedderInput& input) const {
+    std::vector<size_t> indices = TokenIndexer.Index(input.Tokens);
     std::unordered_map<size_t, size_t> wordsCounts;
     for (size_t wordIndex : indices) {
         wordsCounts[wordIndex] += 1;
@@ -13,7 +13,7 @@ public:
 
     explicit TTfIdfEmbedder(tg::TEmbedderConfig config);
 
-    std::vector<float> CalcEmbedding(const std::string& input) const override;
+    std::vector<float> CalcEmbedding(const TEmbedderInput& input) const override;
 
 private:
     TTokenIndexer TokenIndexer;
@@ -1,9 +1,7 @@
 #include "token_indexer.h"
 #include "../util.h"
 
-#include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/split.hpp>
-
+#include <algorithm>
 #include <fstream>
 
 TTokenIndexer::TTokenIndexer(const std::string& vocabularyPath, size_t maxWords) : MaxWords(maxWords) {
@@ -19,22 +17,19 @@ TTokenIndexer::TTokenIndexer(const std::string& vocabularyPath, size_t maxWords)
     }
 }
 
-std::vector<size_t> TTokenIndexer::Index(const std::string& text) const {
-    std::vector<std::string> words;
-    boost::split(words, text, boost::is_any_of(" "), boost::token_compress_on);
-    if (words.size() > MaxWords) {
-        words.resize(MaxWords);
-    }
-    std::vector<size_t> result(words.size());
-    for (size_t i = 0; i < words.size(); i++) {
-        auto it = Vocabulary.find(words[i]);
+std::vector<size_t> TTokenIndexer::Index(const TTokenSpan& tokens) const {
+    std::vector<size_t> result(std::min(tokens.Size(), MaxWords));
+    std::string word;
+    for (size_t i = 0; i < result.size(); i++) {
+        word.assign(tokens[i]);
+        auto it = Vocabulary.find(word);
         result[i] = (it != Vocabulary.end()) ? static_cast<int>(it->second) : 0;
     }
     return result;
 }
 
-torch::Tensor TTokenIndexer::IndexTorch(const std::string& text) const {
-    std::vector<size_t> indices = Index(text);
+torch::Tensor TTokenIndexer::IndexTorch(const TTokenSpan& tokens) const {
+    std::vector<size_t> indices = Index(tokens);
     torch::Tensor inputs = torch::zeros({static_cast<long long>(indices.size())}, torch::dtype(torch::kLong));
     for (size_t i = 0; i < indices.size(); i++) {
         inputs[i] = static_cast<int>(indices[i]);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../token_stream.h"
+
 #include <torch/script.h>
 
 #include <string>
@@ -9,8 +11,9 @@ class TTokenIndexer {
 public:
     TTokenIndexer(const std::string& vocabularyPath, size_t maxWords);
 
-    std::vector<size_t> Index(const std::string& text) const;
-    torch::Tensor IndexTorch(const std::string& text) const;
+    // Empty tokens are indexed as unknown words
+    std::vector<size_t> Index(const TTokenSpan& tokens) const;
+    torch::Tensor IndexTorch(const TTokenSpan& tokens) const;
     size_t Size() const { return Vocabulary.size(); }
 
 private:
@@ -1,6 +1,8 @@
 #include "torch_embedder.h"
 #include "../util.h"
 
+#include <map>
+
 TTorchEmbedder::TTorchEmbedder(
     const std::string& modelPath,
     const std::string& vocabularyPath,
@@ -21,16 +23,36 @@ TTorchEmbedder::TTorchEmbedder(tg::TEmbedderConfig config) : TTorchEmbedder(
     config.max_words()
 ) {}
 
-std::vector<float> TTorchEmbedder::CalcEmbedding(const std::string& input) const {
-    auto tensor = TokenIndexer.IndexTorch(input);
-    std::vector<torch::jit::IValue> inputs;
-    inputs.emplace_back(tensor.unsqueeze(0));
-    at::Tensor outputTensor = Model.forward(inputs).toTensor().squeeze(0).contiguous();
-    float* outputTensorPtr = outputTensor.data_ptr<float>();
-    size_t size = outputTensor.size(0);
-    std::vector<float> resultVector(size);
-    for (size_t i = 0; i < size; i++) {
-        resultVector[i] = outputTensorPtr[i];
+std::vector<float> TTorchEmbedder::CalcEmbedding(const TEmbedderInput& input) const {
+    return CalcEmbeddings({input}).front();
+}
+
+std::vector<std::vector<float>> TTorchEmbedder::CalcEmbeddings(const std::vector<TEmbedderInput>& inputs) const {
+    // Sequences are not padded, so only the inputs of the same length are stacked together
+    std::vector<torch::Tensor> tensors;
+    tensors.reserve(inputs.size());
+    std::map<long, std::vector<size_t>> lengthToInputs;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        tensors.push_back(TokenIndexer.IndexTorch(inputs[i].Tokens));
+        lengthToInputs[tensors.back().size(0)].push_back(i);
+    }
+
+    std::vector<std::vector<float>> resultVectors(inputs.size());
+    for (const auto& [length, indices] : lengthToInputs) {
+        std::vector<torch::Tensor> batch;
+        batch.reserve(indices.size());
+        for (size_t index : indices) {
+            batch.push_back(tensors[index]);
+        }
+        std::vector<torch::jit::IValue> modelInputs;
+        modelInputs.emplace_back(torch::stack(batch));
+        at::Tensor outputTensor = Model.forward(modelInputs).toTensor().contiguous();
+        const float* outputTensorPtr = outputTensor.data_ptr<float>();
+        size_t outputDim = outputTensor.size(1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            const float* rowPtr = outputTensorPtr + i * outputDim;
+            resultVectors[indices[i]].assign(rowPtr, rowPtr + outputDim);
+        }
     }
-    return resultVector;
+    return resultVectors;
 }
@@ -15,7 +15,8 @@ public:
 
     explicit TTorchEmbedder(tg::TEmbedderConfig config);
 
-    std::vector<float> CalcEmbedding(const std::string& input) const override;
+    std::vector<float> CalcEmbedding(const TEmbedderInput& input) const override;
+    std::vector<std::vector<float>> CalcEmbeddings(const std::vector<TEmbedderInput>& inputs) const override;
 
 private:
     mutable torch::jit::script::Module Model;
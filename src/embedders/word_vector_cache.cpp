@@ -0,0 +1,25 @@
+#include "word_vector_cache.h"
+
+#include <fasttext.h>
+
+const float* TWordVectorCache::Get(const fasttext::FastText& model, std::string_view word) {
+    TModelVectors& vectors = Models[&model];
+    Word.assign(word);
+    auto [it, inserted] = vectors.WordToOffset.try_emplace(Word, ZERO_VECTOR);
+    if (inserted) {
+        const size_t vectorSize = model.getDimension();
+        fasttext::Vector wordVector(vectorSize);
+        model.getWordVector(wordVector, Word);
+        const float norm = wordVector.norm();
+        if (norm >= 0.0001f) {
+            wordVector.mul(1.0f / norm);
+            it->second = vectors.Values.size();
+            vectors.Values.insert(vectors.Values.end(), wordVector.data(), wordVector.data() + vectorSize);
+        }
+    }
+    return it->second != ZERO_VECTOR ? vectors.Values.data() + it->second : nullptr;
+}
+
+void TWordVectorCache::Clear() {
+    Models.clear();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fasttext {
+    class FastText;
+}
+
+// Normalized word vectors of one document. Embedders with the same vector model share them,
+// so every word of the document is looked up once per model.
+// Not thread-safe: a document is embedded by one thread.
+class TWordVectorCache {
+public:
+    // Returns nullptr for the words with a zero vector. The pointer is valid until the next call.
+    const float* Get(const fasttext::FastText& model, std::string_view word);
+    void Clear();
+
+private:
+    static constexpr size_t ZERO_VECTOR = static_cast<size_t>(-1);
+
+    struct TModelVectors {
+        std::unordered_map<std::string, size_t> WordToOffset;
+        std::vector<float> Values;
+    };
+
+private:
+    std::unordered_map<const fasttext::FastText*, TModelVectors> Models;
+    std::string Word;
+};
@@ -0,0 +1,31 @@
+#include "host_interner.h"
+
+#include <mutex>
+
+THostInterner& THostInterner::Instance() {
+    static THostInterner interner;
+    return interner;
+}
+
+uint32_t THostInterner::Intern(const std::string& host) {
+    {
+        std::shared_lock<std::shared_mutex> lock(Mutex);
+        const auto it = Ids.find(host);
+        if (it != Ids.end()) {
+            return it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(Mutex);
+    return Ids.try_emplace(host, static_cast<uint32_t>(Ids.size())).first->second;
+}
+
+uint32_t THostInterner::Find(const std::string& host) const {
+    std::shared_lock<std::shared_mutex> lock(Mutex);
+    const auto it = Ids.find(host);
+    return it != Ids.end() ? it->second : UNKNOWN_HOST_ID;
+}
+
+size_t THostInterner::Size() const {
+    std::shared_lock<std::shared_mutex> lock(Mutex);
+    return Ids.size();
+}
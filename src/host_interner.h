@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+// Process-wide dense ids of hosts, so ratings can be stored in flat arrays.
+// Ids are never removed, the number of distinct hosts is small.
+class THostInterner {
+public:
+    static constexpr uint32_t UNKNOWN_HOST_ID = std::numeric_limits<uint32_t>::max();
+
+    static THostInterner& Instance();
+
+    uint32_t Intern(const std::string& host);
+    // Returns UNKNOWN_HOST_ID for hosts that were never interned
+    uint32_t Find(const std::string& host) const;
+    size_t Size() const;
+
+private:
+    THostInterner() = default;
+
+private:
+    mutable std::shared_mutex Mutex;
+    std::unordered_map<std::string, uint32_t> Ids;
+};
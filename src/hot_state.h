@@ -1,20 +1,111 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <thread>
 
+// Current state shared between one writer and many readers.
+// Readers pin the state without touching its reference counter: a pinned reader increments
+// a counter of its own slot, and the writer waits for the slots to drain before releasing
+// the previous state (two-phase epochs, like SRCU).
 template<class T>
 class THotState {
+private:
+    static constexpr size_t SLOTS_COUNT = 64;
+
+    struct alignas(64) TSlot {
+        std::array<std::atomic<int64_t>, 2> Readers {};
+    };
+
+public:
+    class TPin {
+    public:
+        TPin(TPin&& other) noexcept
+            : Slot(other.Slot)
+            , Epoch(other.Epoch)
+            , State(other.State)
+        {
+            other.Slot = nullptr;
+        }
+        TPin(const TPin&) = delete;
+        TPin& operator=(const TPin&) = delete;
+        TPin& operator=(TPin&&) = delete;
+
+        ~TPin() {
+            if (Slot) {
+                Slot->Readers[Epoch].fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        const T* Get() const { return State; }
+        const T& operator*() const { return *State; }
+        const T* operator->() const { return State; }
+        explicit operator bool() const { return State != nullptr; }
+
+    private:
+        friend class THotState;
+
+        TPin(TSlot* slot, size_t epoch, const T* state)
+            : Slot(slot)
+            , Epoch(epoch)
+            , State(state)
+        {}
+
+    private:
+        TSlot* Slot = nullptr;
+        size_t Epoch = 0;
+        const T* State = nullptr;
+    };
+
 public:
     THotState() = default;
+    THotState(const THotState&) = delete;
+    THotState& operator=(const THotState&) = delete;
 
-    std::shared_ptr<T> AtomicGet() const {
-        return std::atomic_load(&StatePtr);
+    // The state stays alive until the pin is destroyed, pins should be short-living
+    TPin Pin() const {
+        TSlot& slot = Slots[GetThreadSlotIndex()];
+        const size_t epoch = Epoch.load(std::memory_order_seq_cst);
+        slot.Readers[epoch].fetch_add(1, std::memory_order_seq_cst);
+        return TPin(&slot, epoch, State.load(std::memory_order_seq_cst));
     }
 
+    // Blocks until all the readers of the previous state unpin it
     void AtomicSet(std::shared_ptr<T> newStatePtr) {
-        std::atomic_store(&StatePtr, newStatePtr);
+        std::lock_guard<std::mutex> lock(WriterMutex);
+        State.store(newStatePtr.get(), std::memory_order_seq_cst);
+        std::swap(StatePtr, newStatePtr);
+        // Readers of the previous state can be in the both epochs, new readers move to the other one
+        for (size_t i = 0; i < 2; ++i) {
+            const size_t epoch = Epoch.load(std::memory_order_relaxed);
+            Epoch.store(epoch ^ 1, std::memory_order_seq_cst);
+            WaitForReaders(epoch);
+        }
+    }
+
+private:
+    void WaitForReaders(size_t epoch) const {
+        for (const TSlot& slot : Slots) {
+            while (slot.Readers[epoch].load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    static size_t GetThreadSlotIndex() {
+        static std::atomic<size_t> threadsCount {0};
+        static thread_local const size_t slotIndex = threadsCount.fetch_add(1, std::memory_order_relaxed) % SLOTS_COUNT;
+        return slotIndex;
     }
 
 private:
+    mutable std::array<TSlot, SLOTS_COUNT> Slots;
+    std::atomic<size_t> Epoch {0};
+    std::atomic<const T*> State {nullptr};
+
+    std::mutex WriterMutex;
     std::shared_ptr<T> StatePtr;
 };
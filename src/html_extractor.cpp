@@ -0,0 +1,545 @@
+#include "html_extractor.h"
+#include "document.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Same as TINYXML2_MAX_ELEMENT_DEPTH, the document itself is the first level
+constexpr size_t MAX_DEPTH = 100;
+
+struct TEntity {
+    std::string_view Pattern;
+    char Value;
+};
+
+constexpr TEntity ENTITIES[] = {
+    {"quot", '"'},
+    {"amp", '&'},
+    {"apos", '\''},
+    {"lt", '<'},
+    {"gt", '>'}
+};
+
+// Character classes of tinyxml2::XMLUtil in the C locale
+bool IsWhiteSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool IsNameStartChar(char c) {
+    const unsigned char byte = static_cast<unsigned char>(c);
+    return byte >= 128 || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || byte == ':' || byte == '_';
+}
+
+bool IsNameChar(char c) {
+    return IsNameStartChar(c) || (c >= '0' && c <= '9') || c == '.' || c == '-';
+}
+
+const char* SkipWhiteSpace(const char* p, const char* end) {
+    while (p < end && IsWhiteSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+bool StartsWith(const char* p, const char* end, std::string_view prefix) {
+    return static_cast<size_t>(end - p) >= prefix.size() && std::memcmp(p, prefix.data(), prefix.size()) == 0;
+}
+
+// Returns the position after the terminator or nullptr if there is none
+const char* SkipPast(const char* p, const char* end, std::string_view terminator) {
+    const std::string_view text(p, end - p);
+    const size_t position = text.find(terminator);
+    return position == std::string_view::npos ? nullptr : p + position + terminator.size();
+}
+
+std::string_view ParseName(const char*& p, const char* end) {
+    if (p >= end || !IsNameStartChar(*p)) {
+        return {};
+    }
+    const char* begin = p;
+    ++p;
+    while (p < end && IsNameChar(*p)) {
+        ++p;
+    }
+    return std::string_view(begin, p - begin);
+}
+
+// Same as tinyxml2::XMLUtil::ConvertUTF32ToUTF8
+size_t ConvertUTF32ToUTF8(unsigned long input, char* output) {
+    size_t length = 0;
+    if (input < 0x80) {
+        length = 1;
+    } else if (input < 0x800) {
+        length = 2;
+    } else if (input < 0x10000) {
+        length = 3;
+    } else if (input < 0x200000) {
+        length = 4;
+    } else {
+        return 0;
+    }
+    static const unsigned long FIRST_BYTE_MARK[5] = {0x00, 0x00, 0xC0, 0xE0, 0xF0};
+    for (size_t i = length - 1; i > 0; --i) {
+        output[i] = static_cast<char>((input | 0x80) & 0xBF);
+        input >>= 6;
+    }
+    output[0] = static_cast<char>(input | FIRST_BYTE_MARK[length]);
+    return length;
+}
+
+// Same as tinyxml2::XMLUtil::GetCharacterRef for p pointing to "&#".
+// Returns the position after the reference or nullptr if it is not a valid one.
+const char* ParseCharacterRef(const char* p, const char* end, char* value, size_t* length) {
+    *length = 0;
+    if (p + 2 >= end) {
+        return p + 1;
+    }
+    const bool isHex = p[2] == 'x';
+    const char* digitsBegin = p + (isHex ? 3 : 2);
+    if (digitsBegin >= end) {
+        return nullptr;
+    }
+    const char* semicolon = std::find(digitsBegin, end, ';');
+    if (semicolon == end) {
+        return nullptr;
+    }
+    unsigned long ucs = 0;
+    unsigned int mult = 1;
+    // Digits are read backwards up to the 'x' or '#', as tinyxml2 does
+    for (const char* q = semicolon - 1; *q != (isHex ? 'x' : '#'); --q) {
+        unsigned int digit = 0;
+        if (*q >= '0' && *q <= '9') {
+            digit = *q - '0';
+        } else if (isHex && *q >= 'a' && *q <= 'f') {
+            digit = *q - 'a' + 10;
+        } else if (isHex && *q >= 'A' && *q <= 'F') {
+            digit = *q - 'A' + 10;
+        } else {
+            return nullptr;
+        }
+        const unsigned int digitScaled = mult * digit;
+        ucs += digitScaled;
+        mult *= isHex ? 16 : 10;
+    }
+    *length = ConvertUTF32ToUTF8(ucs, value);
+    return semicolon + 1;
+}
+
+// Appends the value the way tinyxml2::StrPair::GetStr makes it, quirks included:
+// a reference to U+0000 ends the value, an unknown entity is replaced by the input byte
+// at the current output position.
+void AppendDecoded(std::string_view raw, bool processEntities, std::string* output) {
+    const char* const begin = raw.data();
+    const char* const end = begin + raw.size();
+    const char* p = begin;
+    size_t written = 0;
+    const auto write = [&](char c) {
+        output->push_back(c);
+        ++written;
+    };
+    while (p < end) {
+        const char c = *p;
+        const char next = p + 1 < end ? p[1] : '\0';
+        if (c == '\r' || c == '\n') {
+            // CR LF, LF CR, CR and LF all become LF
+            p += next == (c == '\r' ? '\n' : '\r') ? 2 : 1;
+            write('\n');
+        } else if (processEntities && c == '&' && next == '#') {
+            char value[4];
+            size_t length = 0;
+            const char* adjusted = ParseCharacterRef(p, end, value, &length);
+            if (!adjusted) {
+                write(c);
+                ++p;
+                continue;
+            }
+            for (size_t i = 0; i < length; ++i) {
+                if (value[i] == '\0') {
+                    return;
+                }
+                write(value[i]);
+            }
+            p = adjusted;
+        } else if (processEntities && c == '&') {
+            const TEntity* entity = std::find_if(std::begin(ENTITIES), std::end(ENTITIES), [&](const TEntity& e) {
+                return p + e.Pattern.size() + 1 < end
+                    && std::string_view(p + 1, e.Pattern.size()) == e.Pattern
+                    && p[e.Pattern.size() + 1] == ';';
+            });
+            if (entity != std::end(ENTITIES)) {
+                write(entity->Value);
+                p += entity->Pattern.size() + 2;
+            } else {
+                write(begin[written]);
+                ++p;
+            }
+        } else {
+            // Plain characters are copied in runs
+            const char* runEnd = p + 1;
+            while (runEnd < end && *runEnd != '\r' && *runEnd != '\n' && (*runEnd != '&' || !processEntities)) {
+                ++runEnd;
+            }
+            output->append(p, runEnd);
+            written += runEnd - p;
+            p = runEnd;
+        }
+    }
+}
+
+}
+
+THtmlExtractor::THtmlExtractor(bool parseLinks, bool shrinkText, size_t maxWords)
+    : ParseLinks(parseLinks)
+    , ShrinkText(shrinkText)
+    , MaxWords(maxWords)
+{}
+
+void THtmlExtractor::Extract(const char* data, size_t size, TDocument* document) {
+    Reset(document);
+    // tinyxml2 reads the input as a C string
+    const char* end = size != 0 ? data + strnlen(data, size) : data;
+    // Decoded text is never longer than its source
+    Document->Text.reserve(Document->Text.size() + (end - data));
+
+    const char* p = SkipWhiteSpace(data, end);
+    if (StartsWith(p, end, "\xEF\xBB\xBF")) {
+        p += 3;
+    }
+    // The html element is kept if it was parsed before an error, like in the partially loaded tinyxml2 DOM
+    Parse(p, end);
+    if (!IsHtmlFinished) {
+        throw std::runtime_error("Parser error: no html tag");
+    }
+    if (!HasHead) {
+        throw std::runtime_error("Parser error: no head");
+    }
+    if (!HasMeta) {
+        throw std::runtime_error("Parser error: no meta");
+    }
+    if (!HasBody) {
+        throw std::runtime_error("Parser error: no body");
+    }
+    if (!HasArticle) {
+        throw std::runtime_error("Parser error: no article");
+    }
+}
+
+void THtmlExtractor::Reset(TDocument* document) {
+    Document = document;
+    Stack.clear();
+    Attributes.clear();
+    HasHtml = false;
+    IsHtmlFinished = false;
+    HasHead = false;
+    HasMeta = false;
+    HasBody = false;
+    HasArticle = false;
+    HasAddress = false;
+    HasTime = false;
+    HasAuthorLink = false;
+    IsAuthorPending = false;
+    WordCount = 0;
+    ParagraphBegin = 0;
+}
+
+bool THtmlExtractor::Parse(const char* p, const char* end) {
+    // Declarations are allowed only on the top level before any other node
+    bool onlyDeclarations = true;
+    while (true) {
+        const char* nodeBegin = p;
+        p = SkipWhiteSpace(p, end);
+        if (p == end) {
+            return Stack.empty();
+        }
+        const bool isTopLevel = Stack.empty();
+        const bool isMarkup = *p == '<' && p + 1 < end && (p[1] == '?' || p[1] == '!');
+        if (isMarkup && p[1] == '?') {
+            if (!isTopLevel || !onlyDeclarations) {
+                return false;
+            }
+            p = SkipPast(p + 2, end, "?>");
+            if (!p) {
+                return false;
+            }
+            continue;
+        }
+        if (isTopLevel) {
+            onlyDeclarations = false;
+        }
+
+        if (isMarkup && StartsWith(p, end, "<!--")) {
+            p = SkipPast(p + 4, end, "-->");
+            if (!p) {
+                return false;
+            }
+            OnOtherNode();
+        } else if (isMarkup && StartsWith(p, end, "<![CDATA[")) {
+            const char* valueBegin = p + 9;
+            p = SkipPast(valueBegin, end, "]]>");
+            if (!p) {
+                return false;
+            }
+            OnText(std::string_view(valueBegin, p - 3 - valueBegin), /* processEntities */ false);
+        } else if (isMarkup) {
+            p = SkipPast(p + 2, end, ">");
+            if (!p) {
+                return false;
+            }
+            OnOtherNode();
+        } else if (*p == '<') {
+            ++p;
+            TTag tag;
+            if (!ParseTag(p, end, &tag)) {
+                return false;
+            }
+            if (tag.ClosingType == CT_CLOSING) {
+                if (isTopLevel) {
+                    // tinyxml2 stops at the unmatched closing tag without an error
+                    return true;
+                }
+                if (Stack.back().Name != tag.Name) {
+                    return false;
+                }
+                const ERole role = Stack.back().Role;
+                Stack.pop_back();
+                OnElementEnd(role);
+                if (IsHtmlFinished) {
+                    // Nothing after the html element changes the result
+                    return true;
+                }
+                continue;
+            }
+            OnOtherNode();
+            const ERole role = OnElementStart(tag.Name);
+            if (tag.ClosingType == CT_CLOSED) {
+                OnElementEnd(role);
+                if (IsHtmlFinished) {
+                    return true;
+                }
+                continue;
+            }
+            if (Stack.size() + 2 >= MAX_DEPTH) {
+                return false;
+            }
+            Stack.push_back({tag.Name, role});
+        } else {
+            // Leading whitespaces belong to the text, the text must be followed by a tag
+            const char* textEnd = std::find(p, end, '<');
+            if (textEnd == end || textEnd + 1 == end) {
+                return false;
+            }
+            OnText(std::string_view(nodeBegin, textEnd - nodeBegin), /* processEntities */ true);
+            p = textEnd;
+        }
+    }
+}
+
+bool THtmlExtractor::ParseTag(const char*& p, const char* end, TTag* tag) {
+    p = SkipWhiteSpace(p, end);
+    if (p < end && *p == '/') {
+        tag->ClosingType = CT_CLOSING;
+        ++p;
+    }
+    tag->Name = ParseName(p, end);
+    if (tag->Name.empty()) {
+        return false;
+    }
+
+    Attributes.clear();
+    while (true) {
+        p = SkipWhiteSpace(p, end);
+        if (p == end) {
+            return false;
+        }
+        if (IsNameStartChar(*p)) {
+            TAttribute attribute;
+            attribute.Name = ParseName(p, end);
+            p = SkipWhiteSpace(p, end);
+            if (p == end || *p != '=') {
+                return false;
+            }
+            p = SkipWhiteSpace(p + 1, end);
+            if (p == end || (*p != '"' && *p != '\'')) {
+                return false;
+            }
+            const char* valueEnd = std::find(p + 1, end, *p);
+            if (valueEnd == end) {
+                return false;
+            }
+            attribute.Value = std::string_view(p + 1, valueEnd - p - 1);
+            p = valueEnd + 1;
+            if (FindAttribute(attribute.Name)) {
+                return false;
+            }
+            Attributes.push_back(attribute);
+        } else if (*p == '>') {
+            ++p;
+            return true;
+        } else if (*p == '/' && p + 1 < end && p[1] == '>') {
+            // Even "</name/>" is an empty element for tinyxml2
+            tag->ClosingType = CT_CLOSED;
+            p += 2;
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+THtmlExtractor::ERole THtmlExtractor::OnElementStart(std::string_view name) {
+    const ERole parentRole = Stack.empty() ? R_IGNORED : Stack.back().Role;
+    if (Stack.empty()) {
+        if (name == "html" && !HasHtml) {
+            HasHtml = true;
+            return R_HTML;
+        }
+        return R_IGNORED;
+    }
+    switch (parentRole) {
+        case R_HTML:
+            if (name == "head" && !HasHead) {
+                HasHead = true;
+                return R_HEAD;
+            }
+            if (name == "body" && !HasBody) {
+                HasBody = true;
+                return R_BODY;
+            }
+            return R_IGNORED;
+        case R_HEAD:
+            if (name == "meta") {
+                HasMeta = true;
+                OnMeta();
+            }
+            return R_IGNORED;
+        case R_BODY:
+            if (name == "article" && !HasArticle) {
+                HasArticle = true;
+                return R_ARTICLE;
+            }
+            return R_IGNORED;
+        case R_ARTICLE:
+            if (name == "p" && (!ShrinkText || WordCount < MaxWords)) {
+                ParagraphBegin = Document->Text.size();
+                return R_PARAGRAPH;
+            }
+            if (name == "address" && !HasAddress) {
+                HasAddress = true;
+                return R_ADDRESS;
+            }
+            return R_IGNORED;
+        case R_PARAGRAPH:
+        case R_PARAGRAPH_CHILD:
+            if (ParseLinks && name == "a") {
+                if (const TAttribute* href = FindAttribute("href")) {
+                    Document->OutLinks.emplace_back();
+                    AppendDecoded(href->Value, true, &Document->OutLinks.back());
+                }
+            }
+            return R_PARAGRAPH_CHILD;
+        case R_ADDRESS:
+            if (name == "time" && !HasTime) {
+                HasTime = true;
+                if (const TAttribute* datetime = FindAttribute("datetime")) {
+                    Value.clear();
+                    AppendDecoded(datetime->Value, true, &Value);
+                    Document->PubTime = DateToTimestamp(Value);
+                }
+                return R_IGNORED;
+            }
+            if (name == "a" && !HasAuthorLink) {
+                HasAuthorLink = true;
+                const TAttribute* rel = FindAttribute("rel");
+                if (!rel) {
+                    return R_IGNORED;
+                }
+                Value.clear();
+                AppendDecoded(rel->Value, true, &Value);
+                if (Value != "author") {
+                    return R_IGNORED;
+                }
+                IsAuthorPending = true;
+                return R_AUTHOR;
+            }
+            return R_IGNORED;
+        default:
+            return R_IGNORED;
+    }
+}
+
+void THtmlExtractor::OnElementEnd(ERole role) {
+    if (role == R_HTML) {
+        IsHtmlFinished = true;
+    } else if (role == R_PARAGRAPH) {
+        std::string& text = Document->Text;
+        if (ShrinkText) {
+            WordCount += CountWords(std::string_view(text).substr(ParagraphBegin));
+        }
+        text.push_back('\n');
+    } else if (role == R_AUTHOR) {
+        IsAuthorPending = false;
+    }
+}
+
+void THtmlExtractor::OnText(std::string_view value, bool processEntities) {
+    if (Stack.empty()) {
+        return;
+    }
+    const ERole role = Stack.back().Role;
+    if (role == R_PARAGRAPH || role == R_PARAGRAPH_CHILD) {
+        AppendDecoded(value, processEntities, &Document->Text);
+    } else if (role == R_AUTHOR && IsAuthorPending) {
+        IsAuthorPending = false;
+        Document->Author.clear();
+        AppendDecoded(value, processEntities, &Document->Author);
+    }
+}
+
+void THtmlExtractor::OnOtherNode() {
+    // The author is set only if the first child of the link is a text
+    if (IsAuthorPending && Stack.back().Role == R_AUTHOR) {
+        IsAuthorPending = false;
+    }
+}
+
+void THtmlExtractor::OnMeta() {
+    const TAttribute* property = FindAttribute("property");
+    const TAttribute* content = FindAttribute("content");
+    if (!property || !content) {
+        return;
+    }
+    Value.clear();
+    AppendDecoded(property->Value, true, &Value);
+    std::string* field = nullptr;
+    if (Value == "og:title") {
+        field = &Document->Title;
+    } else if (Value == "og:url") {
+        field = &Document->Url;
+    } else if (Value == "og:site_name") {
+        field = &Document->SiteName;
+    } else if (Value == "og:description") {
+        field = &Document->Description;
+    } else if (Value == "article:published_time") {
+        Value.clear();
+        AppendDecoded(content->Value, true, &Value);
+        Document->FetchTime = DateToTimestamp(Value);
+        return;
+    } else {
+        return;
+    }
+    field->clear();
+    AppendDecoded(content->Value, true, field);
+}
+
+const THtmlExtractor::TAttribute* THtmlExtractor::FindAttribute(std::string_view name) const {
+    for (const TAttribute& attribute : Attributes) {
+        if (attribute.Name == name) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TDocument;
+
+// One-pass extractor of the contest html schema: html/head/meta, html/body/article/p and
+// html/body/article/address. Parsing rules are the ones of tinyxml2::XMLDocument::LoadFile
+// (well-formedness errors, dropped whitespace-only texts, entities, newlines), so the fields
+// are the same as after walking the tinyxml2 DOM. No DOM is built: tags are read in place
+// and texts are decoded right into the document fields.
+class THtmlExtractor {
+public:
+    THtmlExtractor(bool parseLinks, bool shrinkText, size_t maxWords);
+
+    // Throws std::runtime_error if there is no html/head/meta or html/body/article
+    void Extract(const char* data, size_t size, TDocument* document);
+
+private:
+    enum ERole {
+        R_IGNORED,
+        R_HTML,
+        R_HEAD,
+        R_BODY,
+        R_ARTICLE,
+        R_PARAGRAPH,
+        R_PARAGRAPH_CHILD,
+        R_ADDRESS,
+        R_AUTHOR
+    };
+
+    enum EClosingType {
+        CT_OPEN,
+        CT_CLOSED,
+        CT_CLOSING
+    };
+
+    struct TAttribute {
+        std::string_view Name;
+        std::string_view Value;
+    };
+
+    struct TTag {
+        std::string_view Name;
+        EClosingType ClosingType = CT_OPEN;
+    };
+
+    struct TFrame {
+        std::string_view Name;
+        ERole Role = R_IGNORED;
+    };
+
+    void Reset(TDocument* document);
+    // Returns false on malformed input
+    bool Parse(const char* p, const char* end);
+    bool ParseTag(const char*& p, const char* end, TTag* tag);
+
+    ERole OnElementStart(std::string_view name);
+    void OnElementEnd(ERole role);
+    void OnText(std::string_view value, bool processEntities);
+    void OnOtherNode();
+
+    void OnMeta();
+    const TAttribute* FindAttribute(std::string_view name) const;
+
+private:
+    const bool ParseLinks;
+    const bool ShrinkText;
+    const size_t MaxWords;
+
+    TDocument* Document = nullptr;
+    std::vector<TFrame> Stack;
+    std::vector<TAttribute> Attributes;
+    std::string Value;
+
+    bool HasHtml = false;
+    bool IsHtmlFinished = false;
+    bool HasHead = false;
+    bool HasMeta = false;
+    bool HasBody = false;
+    bool HasArticle = false;
+    bool HasAddress = false;
+    bool HasTime = false;
+    bool HasAuthorLink = false;
+    bool IsAuthorPending = false;
+    size_t WordCount = 0;
+    size_t ParagraphBegin = 0;
+};
@@ -0,0 +1,75 @@
+#include "json_writer.h"
+#include "util.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr int PRETTY_INDENT = 4;
+
+}
+
+TJsonArrayWriter::TJsonArrayWriter(std::ostream& output, tg::EOutputFormat format, const std::string& objectKey)
+    : Output(output)
+    , Format(format)
+    , IsWrapped(!objectKey.empty() && format != tg::OF_NDJSON)
+    , Indent(IsWrapped ? 2 * PRETTY_INDENT : PRETTY_INDENT, ' ')
+{
+    ENSURE(Format == tg::OF_PRETTY || Format == tg::OF_COMPACT || Format == tg::OF_NDJSON, "Bad output format");
+    if (Format == tg::OF_NDJSON) {
+        return;
+    }
+    if (IsWrapped) {
+        const std::string key = nlohmann::json(objectKey).dump();
+        if (Format == tg::OF_PRETTY) {
+            Output << "{\n" << std::string(PRETTY_INDENT, ' ') << key << ": ";
+        } else {
+            Output << "{" << key << ":";
+        }
+    }
+    Output << "[";
+}
+
+void TJsonArrayWriter::Write(const nlohmann::json& element) {
+    ENSURE(!IsFinished, "Write after Finish");
+    if (Format == tg::OF_NDJSON) {
+        Output << element.dump() << "\n";
+        return;
+    }
+    if (ElementsCount != 0) {
+        Output << ",";
+    }
+    if (Format == tg::OF_PRETTY) {
+        // String values are escaped, so every line break belongs to the layout and gets the array indent
+        const std::string dumped = element.dump(PRETTY_INDENT);
+        size_t lineBegin = 0;
+        while (lineBegin < dumped.size()) {
+            const size_t lineEnd = std::min(dumped.find('\n', lineBegin), dumped.size());
+            Output << "\n" << Indent;
+            Output.write(dumped.data() + lineBegin, lineEnd - lineBegin);
+            lineBegin = lineEnd + 1;
+        }
+    } else {
+        Output << element.dump();
+    }
+    ++ElementsCount;
+}
+
+void TJsonArrayWriter::Finish() {
+    if (IsFinished) {
+        return;
+    }
+    IsFinished = true;
+    if (Format == tg::OF_NDJSON) {
+        Output.flush();
+        return;
+    }
+    if (Format == tg::OF_PRETTY && ElementsCount != 0) {
+        Output << "\n" << std::string(IsWrapped ? PRETTY_INDENT : 0, ' ');
+    }
+    Output << "]";
+    if (IsWrapped) {
+        Output << (Format == tg::OF_PRETTY ? "\n}" : "}");
+    }
+    Output << std::endl;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "enum.pb.h"
+
+#include <nlohmann_json/json.hpp>
+
+#include <ostream>
+#include <string>
+
+// Writes a JSON array element by element instead of building it in memory.
+// OF_PRETTY output is the same as dump(4) of the whole array, OF_COMPACT is the same as dump(),
+// OF_NDJSON writes every element as a compact line without the enclosing array.
+class TJsonArrayWriter {
+public:
+    // Non-empty objectKey wraps the array into an object: {"objectKey": [...]}. It is ignored for OF_NDJSON.
+    TJsonArrayWriter(std::ostream& output, tg::EOutputFormat format, const std::string& objectKey = "");
+
+    void Write(const nlohmann::json& element);
+    // Closes the array, nothing can be written after it
+    void Finish();
+
+private:
+    std::ostream& Output;
+    const tg::EOutputFormat Format;
+    const bool IsWrapped;
+    const std::string Indent;
+    size_t ElementsCount = 0;
+    bool IsFinished = false;
+};
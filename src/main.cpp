@@ -1,5 +1,8 @@
 #include "annotator.h"
 #include "clusterer.h"
+#include "document_archive.h"
+#include "document_snapshot.h"
+#include "json_writer.h"
 #include "ranker.h"
 #include "run_server.h"
 #include "summarizer.h"
@@ -28,6 +31,9 @@ int main(int argc, char** argv) {
             ("languages", po::value<std::vector<std::string>>()->multitoken()->default_value(std::vector<std::string>{"ru", "en"}, "ru en"), "languages")
             ("window_size", po::value<uint64_t>()->default_value(3600*8), "window_size")
             ("print_top_debug_info", po::bool_switch()->default_value(false), "print_top_debug_info")
+            ("save_snapshot", po::value<std::string>()->default_value(""), "save_snapshot")
+            ("output_format", po::value<std::string>()->default_value("pretty"), "output_format: pretty, compact or ndjson")
+            ("output", po::value<std::string>()->default_value("data.tgar"), "output: archive path for the pack mode")
             ;
 
         po::positional_options_description p;
@@ -55,7 +61,8 @@ int main(int argc, char** argv) {
             "categories",
             "threads",
             "top",
-            "server"
+            "server",
+            "pack"
         };
         if (std::find(modes.begin(), modes.end(), mode) == modes.end()) {
             std::cerr << "Unknown or unsupported mode!" << std::endl;
@@ -83,6 +90,13 @@ int main(int argc, char** argv) {
             return RunServer(serverConfig, port.value());
         }
 
+        const std::string outputFormatStr = vm["output_format"].as<std::string>();
+        const tg::EOutputFormat outputFormat = FromString<tg::EOutputFormat>(outputFormatStr);
+        if (outputFormat == tg::OF_UNDEFINED) {
+            std::cerr << "Unknown output format: " << outputFormatStr << std::endl;
+            return -1;
+        }
+
         // Read file names
         LOG_DEBUG("Reading file names...");
         std::string input = vm["input"].as<std::string>();
@@ -96,6 +110,14 @@ int main(int argc, char** argv) {
             inputFormat = tg::IF_JSONL;
             fileNames.push_back(input);
             LOG_DEBUG("JSONL file as input");
+        } else if (boost::algorithm::ends_with(input, ".snapshot")) {
+            inputFormat = tg::IF_SNAPSHOT;
+            fileNames.push_back(input);
+            LOG_DEBUG("Snapshot as input");
+        } else if (boost::algorithm::ends_with(input, ".tgar")) {
+            inputFormat = tg::IF_ARCHIVE;
+            fileNames.push_back(input);
+            LOG_DEBUG("Archive as input");
         } else {
             inputFormat = tg::IF_HTML;
             int nDocs = vm["ndocs"].as<int>();
@@ -103,18 +125,62 @@ int main(int argc, char** argv) {
             LOG_DEBUG("Files count: " << fileNames.size());
         }
 
+        if (mode == "pack") {
+            if (inputFormat != tg::IF_HTML) {
+                std::cerr << "Only html directories can be packed" << std::endl;
+                return -1;
+            }
+            const std::string archivePath = vm["output"].as<std::string>();
+            const size_t packedCount = TDocumentArchive::Pack(archivePath, fileNames);
+            LOG_DEBUG("Archive saved to " << archivePath << " (" << packedCount << " documents)");
+            return 0;
+        }
+
         // Parse files and annotate with classifiers
         const std::string annotatorConfigPath = vm["annotator_config"].as<std::string>();
         bool saveNotNews = vm["save_not_news"].as<bool>();
         std::vector<std::string> languages = vm["languages"].as<std::vector<std::string>>();
-        TAnnotator annotator(annotatorConfigPath, languages, saveNotNews, mode);
-        TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> annotationTimer;
-        std::vector<TDbDocument> docs = annotator.AnnotateAll(fileNames, inputFormat);
-        LOG_DEBUG("Annotation: " << annotationTimer.Elapsed() << " ms (" << docs.size() << " documents)");
+        const std::string snapshotPath = vm["save_snapshot"].as<std::string>();
+        std::vector<TDbDocument> docs;
+        if (inputFormat == tg::IF_SNAPSHOT) {
+            // Snapshot documents are already annotated, texts are not stored there
+            TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> snapshotTimer;
+            docs = TDocumentSnapshot(input).GetDocuments();
+            std::set<tg::ELanguage> allowedLanguages;
+            for (const std::string& language : languages) {
+                allowedLanguages.insert(FromString<tg::ELanguage>(language));
+            }
+            docs.erase(std::remove_if(docs.begin(), docs.end(), [&](const TDbDocument& doc) {
+                return allowedLanguages.find(doc.Language) == allowedLanguages.end() || (!doc.IsNews() && !saveNotNews);
+            }), docs.end());
+            LOG_DEBUG("Snapshot reading: " << snapshotTimer.Elapsed() << " ms (" << docs.size() << " documents)");
+        } else {
+            TAnnotator annotator(annotatorConfigPath, languages, saveNotNews, mode);
+            TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> annotationTimer;
+            if (mode == "json" && snapshotPath.empty()) {
+                // Documents are written as soon as they are annotated and are not kept in memory
+                TJsonArrayWriter writer(std::cout, outputFormat);
+                size_t docsCount = 0;
+                annotator.AnnotateStream(fileNames, inputFormat, [&](TDbDocument&& doc) {
+                    writer.Write(doc.ToJson());
+                    docsCount++;
+                });
+                writer.Finish();
+                LOG_DEBUG("Annotation: " << annotationTimer.Elapsed() << " ms (" << docsCount << " documents)");
+                return 0;
+            }
+            docs = annotator.AnnotateAll(fileNames, inputFormat);
+            LOG_DEBUG("Annotation: " << annotationTimer.Elapsed() << " ms (" << docs.size() << " documents)");
+        }
+
+        if (!snapshotPath.empty()) {
+            TDocumentSnapshot::Write(snapshotPath, docs);
+            LOG_DEBUG("Snapshot saved to " << snapshotPath);
+        }
 
         // Output
         if (mode == "languages") {
-            nlohmann::json outputJson = nlohmann::json::array();
+            TJsonArrayWriter writer(std::cout, outputFormat);
             std::map<std::string, std::vector<std::string>> langToFiles;
             for (const TDbDocument& doc : docs) {
                 langToFiles[nlohmann::json(doc.Language)].push_back(CleanFileName(doc.FileName));
@@ -126,28 +192,26 @@ int main(int argc, char** argv) {
                     {"lang_code", language},
                     {"articles", files}
                 };
-                outputJson.push_back(object);
+                writer.Write(object);
             }
-            std::cout << outputJson.dump(4) << std::endl;
+            writer.Finish();
             return 0;
         } else if (mode == "json") {
-            nlohmann::json outputJson = nlohmann::json::array();
+            TJsonArrayWriter writer(std::cout, outputFormat);
             for (const TDbDocument& doc : docs) {
-                outputJson.push_back(doc.ToJson());
+                writer.Write(doc.ToJson());
             }
-            std::cout << outputJson.dump(4) << std::endl;
+            writer.Finish();
             return 0;
         } else if (mode == "news") {
-            nlohmann::json articles = nlohmann::json::array();
+            TJsonArrayWriter writer(std::cout, outputFormat, "articles");
             for (const TDbDocument& doc : docs) {
-                articles.push_back(CleanFileName(doc.FileName));
+                writer.Write(CleanFileName(doc.FileName));
             }
-            nlohmann::json outputJson = nlohmann::json::object();
-            outputJson["articles"] = articles;
-            std::cout << outputJson.dump(4) << std::endl;
+            writer.Finish();
             return 0;
         } else if (mode == "categories") {
-            nlohmann::json outputJson = nlohmann::json::array();
+            TJsonArrayWriter writer(std::cout, outputFormat);
 
             std::vector<std::vector<std::string>> catToFiles(tg::ECategory_ARRAYSIZE);
             for (const TDbDocument& doc : docs) {
@@ -171,9 +235,9 @@ int main(int argc, char** argv) {
                     {"category", category},
                     {"articles", files}
                 };
-                outputJson.push_back(object);
+                writer.Write(object);
             }
-            std::cout << outputJson.dump(4) << std::endl;
+            writer.Finish();
             return 0;
         } else if (mode != "threads" && mode != "top") {
             assert(false);
@@ -189,7 +253,7 @@ int main(int argc, char** argv) {
             LOG_DEBUG(nlohmann::json(language) << ": " << langClusters.size() << " clusters");
         }
         if (mode == "threads") {
-            nlohmann::json outputJson = nlohmann::json::array();
+            TJsonArrayWriter writer(std::cout, outputFormat);
             for (const auto& [language, langClusters]: clusterIndex.Clusters) {
                 for (const auto& cluster : langClusters) {
                     nlohmann::json files = nlohmann::json::array();
@@ -200,7 +264,7 @@ int main(int argc, char** argv) {
                         {"title", cluster.GetTitle()},
                         {"articles", files}
                     };
-                    outputJson.push_back(object);
+                    writer.Write(object);
 
                     if (cluster.GetSize() >= 2) {
                         LOG_DEBUG("\n         CLUSTER: " << cluster.GetTitle());
@@ -210,7 +274,7 @@ int main(int argc, char** argv) {
                     }
                 }
             }
-            std::cout << outputJson.dump(4) << std::endl;
+            writer.Finish();
             return 0;
         } else if (mode != "top") {
             assert(false);
@@ -222,12 +286,15 @@ int main(int argc, char** argv) {
         const std::string summarizerConfigPath = vm["summarizer_config"].as<std::string>();
         const TSummarizer summarizer(summarizerConfigPath);
 
+        TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> summarizationTimer;
+        summarizer.Summarize(clusterIndex.Clusters);
+        LOG_DEBUG("Summarization: " << summarizationTimer.Elapsed() << " ms");
+
         TClusters allClusters;
         for (const auto& language: {tg::LN_EN, tg::LN_RU}) {
             if (clusterIndex.Clusters.find(language) == clusterIndex.Clusters.end()) {
                 continue;
             }
-            summarizer.Summarize(clusterIndex.Clusters.at(language));
             std::copy(
                 clusterIndex.Clusters.at(language).cbegin(),
                 clusterIndex.Clusters.at(language).cend(),
@@ -238,7 +305,7 @@ int main(int argc, char** argv) {
         const std::string rankerConfigPath = vm["ranker_config"].as<std::string>();
         const TRanker ranker(rankerConfigPath);
         const auto tops = ranker.Rank(allClusters.begin(), allClusters.end(), clusterIndex.IterTimestamp, window);
-        nlohmann::json outputJson = nlohmann::json::array();
+        TJsonArrayWriter writer(std::cout, outputFormat);
         for (auto it = tops.begin(); it != tops.end(); ++it) {
             const auto category = static_cast<tg::ECategory>(std::distance(tops.begin(), it));
             if (category == tg::NC_UNDEFINED) {
@@ -285,9 +352,9 @@ int main(int argc, char** argv) {
                 }
                 rubricTop["threads"].push_back(object);
             }
-            outputJson.push_back(rubricTop);
+            writer.Write(rubricTop);
         }
-        std::cout << outputJson.dump(4) << std::endl;
+        writer.Finish();
         return 0;
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
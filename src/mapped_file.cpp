@@ -0,0 +1,80 @@
+#include "mapped_file.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TMappedFile::TMappedFile(const std::string& path, bool populate) {
+    const int fileDesc = open(path.c_str(), O_RDONLY);
+    ENSURE(fileDesc >= 0, "Could not open " << path << ": " << std::strerror(errno));
+    struct stat fileStat;
+    if (fstat(fileDesc, &fileStat) != 0) {
+        close(fileDesc);
+        ENSURE(false, "Could not stat " << path << ": " << std::strerror(errno));
+    }
+    MappedSize = static_cast<size_t>(fileStat.st_size);
+    if (MappedSize != 0) {
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (populate) {
+            flags |= MAP_POPULATE;
+        }
+#else
+        UNUSED(populate);
+#endif
+        void* data = mmap(nullptr, MappedSize, PROT_READ, flags, fileDesc, 0);
+        if (data == MAP_FAILED) {
+            close(fileDesc);
+            ENSURE(false, "Could not mmap " << path << ": " << std::strerror(errno));
+        }
+        MappedData = static_cast<const char*>(data);
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fileDesc);
+}
+
+TMappedFile::~TMappedFile() {
+    Reset();
+}
+
+TMappedFile::TMappedFile(TMappedFile&& other) noexcept
+    : MappedData(std::exchange(other.MappedData, nullptr))
+    , MappedSize(std::exchange(other.MappedSize, 0))
+{
+}
+
+TMappedFile& TMappedFile::operator=(TMappedFile&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        MappedData = std::exchange(other.MappedData, nullptr);
+        MappedSize = std::exchange(other.MappedSize, 0);
+    }
+    return *this;
+}
+
+void TMappedFile::Prefetch(size_t offset, size_t size) const {
+    if (offset >= MappedSize || size == 0) {
+        return;
+    }
+    // madvise needs a page aligned address
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = offset / pageSize * pageSize;
+    const size_t end = offset + std::min(size, MappedSize - offset);
+    // Only a hint, errors are not important
+    madvise(const_cast<char*>(MappedData) + begin, end - begin, MADV_WILLNEED);
+}
+
+void TMappedFile::Reset() {
+    if (MappedData != nullptr) {
+        munmap(const_cast<char*>(MappedData), MappedSize);
+    }
+    MappedData = nullptr;
+    MappedSize = 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class TMappedFile {
+public:
+    // With populate the whole file is read on mapping, so the accesses to the data do not fault page by page
+    explicit TMappedFile(const std::string& path, bool populate = false);
+    ~TMappedFile();
+
+    TMappedFile(const TMappedFile&) = delete;
+    TMappedFile& operator=(const TMappedFile&) = delete;
+    TMappedFile(TMappedFile&& other) noexcept;
+    TMappedFile& operator=(TMappedFile&& other) noexcept;
+
+    const char* Data() const { return MappedData; }
+    size_t Size() const { return MappedSize; }
+
+    // Asks the kernel to read the range into the page cache in the background
+    void Prefetch(size_t offset, size_t size) const;
+
+private:
+    void Reset();
+
+private:
+    const char* MappedData = nullptr;
+    size_t MappedSize = 0;
+};
@@ -1,6 +1,8 @@
 #include "ranker.h"
 #include "util.h"
 
+#include <numeric>
+
 TWeightInfo ComputeClusterWeightPush(
     const TNewsCluster& cluster,
     const uint64_t iterTimestamp,
@@ -23,7 +25,7 @@ TRanker::TRanker(const std::string& configPath) {
     ::ParseConfig(configPath, Config);
 }
 
-std::vector<std::vector<TWeightedNewsCluster>> TRanker::Rank(
+TRankedTops TRanker::Rank(
     TClusters::const_iterator begin,
     TClusters::const_iterator end,
     uint64_t iterTimestamp,
@@ -38,19 +40,11 @@ std::vector<std::vector<TWeightedNewsCluster>> TRanker::Rank(
 
     std::stable_sort(weightedClusters.begin(), weightedClusters.end(),
         [&](const TWeightedNewsCluster& a, const TWeightedNewsCluster& b) {
-            size_t firstSize = a.WeightInfo.ClusterSize;
-            size_t secondSize = b.WeightInfo.ClusterSize;
-            if (firstSize == secondSize) {
-                return a.WeightInfo.Weight > b.WeightInfo.Weight;
-            }
-            if (firstSize < this->Config.min_cluster_size() || secondSize < this->Config.min_cluster_size()) {
-                return firstSize > secondSize;
-            }
-            return a.WeightInfo.Weight > b.WeightInfo.Weight;
+            return IsRankedHigher(a.WeightInfo, b.WeightInfo);
         }
     );
 
-    std::vector<std::vector<TWeightedNewsCluster>> output(tg::ECategory_ARRAYSIZE);
+    TRankedTops output(tg::ECategory_ARRAYSIZE);
     for (const TWeightedNewsCluster& cluster : weightedClusters) {
         auto category = cluster.Cluster.get().GetCategory();
         assert(category != tg::NC_UNDEFINED && category != tg::NC_ANY);
@@ -60,3 +54,81 @@ std::vector<std::vector<TWeightedNewsCluster>> TRanker::Rank(
 
     return output;
 }
+
+std::vector<TWeightedNewsCluster> TRanker::RankTop(
+    TClusters::const_iterator begin,
+    TClusters::const_iterator end,
+    uint64_t iterTimestamp,
+    uint64_t window,
+    tg::ECategory category,
+    size_t limit
+) const {
+    std::vector<TWeightedNewsCluster> weightedClusters;
+    for (TClusters::const_iterator it = begin; it != end; it++) {
+        const TNewsCluster& cluster = *it;
+        if (category != tg::NC_ANY && cluster.GetCategory() != category) {
+            continue;
+        }
+        weightedClusters.emplace_back(cluster, ComputeClusterWeightPush(cluster, iterTimestamp, window));
+    }
+
+    // Ties are broken by the input position, so the prefix is the same as in Rank
+    std::vector<size_t> order(weightedClusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    const auto compare = [&](size_t a, size_t b) {
+        const TWeightInfo& first = weightedClusters[a].WeightInfo;
+        const TWeightInfo& second = weightedClusters[b].WeightInfo;
+        if (IsRankedHigher(first, second)) {
+            return true;
+        }
+        if (IsRankedHigher(second, first)) {
+            return false;
+        }
+        return a < b;
+    };
+    const size_t topSize = std::min(limit, order.size());
+    std::partial_sort(order.begin(), order.begin() + topSize, order.end(), compare);
+
+    std::vector<TWeightedNewsCluster> output;
+    output.reserve(topSize);
+    for (size_t i = 0; i < topSize; ++i) {
+        output.push_back(weightedClusters[order[i]]);
+    }
+    return output;
+}
+
+TRankedTops TRanker::RankPeriod(
+    const TClusters& clusters,
+    uint64_t iterTimestamp,
+    uint64_t trueMaxTimestamp,
+    uint64_t period
+) const {
+    const uint64_t fromTimestamp = trueMaxTimestamp > period ? trueMaxTimestamp - period : 0;
+    const auto indexIt = std::lower_bound(clusters.cbegin(), clusters.cend(), fromTimestamp, TNewsCluster::Compare);
+    const size_t limit = Config.top_size() != 0 ? Config.top_size() : clusters.size();
+
+    TRankedTops output(tg::ECategory_ARRAYSIZE);
+    for (int category = 0; category < tg::ECategory_ARRAYSIZE; ++category) {
+        if (category == tg::NC_UNDEFINED) {
+            continue;
+        }
+        output[category] = RankTop(indexIt, clusters.cend(), iterTimestamp, period, static_cast<tg::ECategory>(category), limit);
+    }
+    return output;
+}
+
+bool TRanker::IsRankedHigher(const TWeightInfo& a, const TWeightInfo& b) const {
+    size_t firstSize = a.ClusterSize;
+    size_t secondSize = b.ClusterSize;
+    if (firstSize == secondSize) {
+        return a.Weight > b.Weight;
+    }
+    if (firstSize < Config.min_cluster_size() || secondSize < Config.min_cluster_size()) {
+        return firstSize > secondSize;
+    }
+    return a.Weight > b.Weight;
+}
+
+std::vector<uint64_t> TRanker::GetPeriodBuckets() const {
+    return std::vector<uint64_t>(Config.period_buckets().cbegin(), Config.period_buckets().cend());
+}
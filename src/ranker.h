@@ -27,17 +27,43 @@ struct TWeightedNewsCluster {
     {}
 };
 
+// Ranked clusters for every category
+using TRankedTops = std::vector<std::vector<TWeightedNewsCluster>>;
+
 class TRanker {
 public:
     TRanker(const std::string& configPath);
 
-    std::vector<std::vector<TWeightedNewsCluster>> Rank(
+    TRankedTops Rank(
         TClusters::const_iterator begin,
         TClusters::const_iterator end,
         uint64_t iterTimestamp,
         uint64_t window
     ) const;
 
+    // Best clusters of the category (or of all categories for NC_ANY) in the same order as in Rank
+    std::vector<TWeightedNewsCluster> RankTop(
+        TClusters::const_iterator begin,
+        TClusters::const_iterator end,
+        uint64_t iterTimestamp,
+        uint64_t window,
+        tg::ECategory category,
+        size_t limit
+    ) const;
+
+    // Clusters should be sorted by the freshest timestamp, only the ones from the last period are ranked
+    TRankedTops RankPeriod(
+        const TClusters& clusters,
+        uint64_t iterTimestamp,
+        uint64_t trueMaxTimestamp,
+        uint64_t period
+    ) const;
+
+    std::vector<uint64_t> GetPeriodBuckets() const;
+
+private:
+    bool IsRankedHigher(const TWeightInfo& a, const TWeightInfo& b) const;
+
 private:
     tg::TRankerConfig Config;
 };
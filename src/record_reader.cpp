@@ -0,0 +1,89 @@
+#include "record_reader.h"
+#include "util.h"
+
+#include <iterator>
+
+TRecordReader::TRecordReader(const std::vector<std::string>& fileNames, tg::EInputFormat inputFormat)
+    : FileNames(fileNames)
+    , InputFormat(inputFormat)
+{
+    ENSURE(InputFormat == tg::IF_JSON || InputFormat == tg::IF_JSONL || InputFormat == tg::IF_HTML, "Bad input format");
+}
+
+bool TRecordReader::Next(std::string* record) {
+    if (InputFormat == tg::IF_HTML) {
+        if (FileIndex >= FileNames.size()) {
+            return false;
+        }
+        *record = FileNames[FileIndex++];
+        return true;
+    }
+    while (Stream || OpenNextFile()) {
+        const bool found = InputFormat == tg::IF_JSONL ? NextLine(record) : NextArrayObject(record);
+        if (found) {
+            return true;
+        }
+        Stream.reset();
+    }
+    return false;
+}
+
+bool TRecordReader::OpenNextFile() {
+    if (FileIndex >= FileNames.size()) {
+        return false;
+    }
+    Stream = std::make_unique<std::ifstream>(FileNames[FileIndex++]);
+    ENSURE(Stream->is_open(), "Can't open " << FileNames[FileIndex - 1]);
+    return true;
+}
+
+bool TRecordReader::NextLine(std::string* record) {
+    while (std::getline(*Stream, *record)) {
+        if (!record->empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TRecordReader::NextArrayObject(std::string* record) {
+    // Top-level objects of the array are cut out by braces, so the whole tree is never built
+    record->clear();
+    size_t depth = 0;
+    bool inString = false;
+    bool isEscaped = false;
+    std::istreambuf_iterator<char> it(*Stream);
+    const std::istreambuf_iterator<char> end;
+    for (; it != end; ++it) {
+        const char c = *it;
+        if (depth == 0) {
+            if (c == '{') {
+                depth = 1;
+                record->push_back(c);
+            }
+            continue;
+        }
+        record->push_back(c);
+        if (inString) {
+            if (isEscaped) {
+                isEscaped = false;
+            } else if (c == '\\') {
+                isEscaped = true;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '{') {
+            ++depth;
+        } else if (c == '}') {
+            --depth;
+            if (depth == 0) {
+                ++it;
+                return true;
+            }
+        }
+    }
+    ENSURE(depth == 0, "Unexpected end of JSON array");
+    return false;
+}
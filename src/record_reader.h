@@ -0,0 +1,29 @@
+#pragma once
+
+#include "enum.pb.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Sequential reader of input records without loading whole files:
+// JSON objects for IF_JSONL and IF_JSON, file paths for IF_HTML
+class TRecordReader {
+public:
+    TRecordReader(const std::vector<std::string>& fileNames, tg::EInputFormat inputFormat);
+
+    // Returns false after the last record
+    bool Next(std::string* record);
+
+private:
+    bool NextLine(std::string* record);
+    bool NextArrayObject(std::string* record);
+    bool OpenNextFile();
+
+private:
+    const std::vector<std::string>& FileNames;
+    const tg::EInputFormat InputFormat;
+    size_t FileIndex = 0;
+    std::unique_ptr<std::ifstream> Stream;
+};
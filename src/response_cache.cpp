@@ -0,0 +1,48 @@
+#include "response_cache.h"
+
+#include <drogon/utils/Utilities.h>
+
+#include <functional>
+
+size_t TThreadsResponseCache::TKeyHash::operator()(const TKey& key) const {
+    size_t hash = std::hash<uint64_t>()(key.Generation);
+    hash = hash * 31 + std::hash<int>()(key.Language);
+    hash = hash * 31 + std::hash<int>()(key.Category);
+    hash = hash * 31 + std::hash<uint64_t>()(key.Period);
+    return hash;
+}
+
+TThreadsResponseCache::TThreadsResponseCache(bool gzip)
+    : Gzip(gzip)
+{}
+
+TThreadsResponseCache::TResponsePtr TThreadsResponseCache::Get(const TKey& key) const {
+    std::lock_guard<std::mutex> lock(Mutex);
+    const auto it = Responses.find(key);
+    return it != Responses.end() ? it->second : nullptr;
+}
+
+TThreadsResponseCache::TResponsePtr TThreadsResponseCache::MakeResponse(std::string&& body) const {
+    auto response = std::make_shared<TResponse>();
+    response->Body = std::move(body);
+    if (Gzip) {
+        response->GzippedBody = drogon::utils::gzipCompress(response->Body.data(), response->Body.size());
+    }
+    return response;
+}
+
+TThreadsResponseCache::TResponsePtr TThreadsResponseCache::Put(const TKey& key, std::string&& body) {
+    TResponsePtr response = MakeResponse(std::move(body));
+
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (key.Generation < Generation) {
+        // Request for the old index finished after the new one had been served
+        return response;
+    }
+    if (key.Generation > Generation) {
+        Responses.clear();
+        Generation = key.Generation;
+    }
+    // Concurrent misses of the same key produce the same body, the first one is kept
+    return Responses.emplace(key, std::move(response)).first->second;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "enum.pb.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Serialized /threads responses of the current index generation.
+// Entries of the previous generations are dropped as soon as a newer one is stored.
+// The period is any number sent by a client, so only the precomputed period buckets should be stored.
+class TThreadsResponseCache {
+public:
+    struct TKey {
+        uint64_t Generation = 0;
+        tg::ELanguage Language = tg::LN_UNDEFINED;
+        tg::ECategory Category = tg::NC_UNDEFINED;
+        uint64_t Period = 0;
+
+        bool operator==(const TKey& other) const {
+            return Generation == other.Generation
+                && Language == other.Language
+                && Category == other.Category
+                && Period == other.Period;
+        }
+    };
+
+    struct TResponse {
+        std::string Body;
+        std::string GzippedBody; // empty if gzip is disabled
+    };
+    using TResponsePtr = std::shared_ptr<const TResponse>;
+
+    explicit TThreadsResponseCache(bool gzip);
+
+    TResponsePtr Get(const TKey& key) const;
+    TResponsePtr Put(const TKey& key, std::string&& body);
+    // Response for a key that is not cached
+    TResponsePtr MakeResponse(std::string&& body) const;
+
+private:
+    struct TKeyHash {
+        size_t operator()(const TKey& key) const;
+    };
+
+private:
+    const bool Gzip;
+
+    mutable std::mutex Mutex;
+    uint64_t Generation = 0;
+    std::unordered_map<TKey, TResponsePtr, TKeyHash> Responses;
+};
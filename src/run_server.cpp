@@ -1,10 +1,12 @@
 #include "run_server.h"
 
+#include "annotation_executor.h"
 #include "annotator.h"
 #include "hot_state.h"
 #include "clusterer.h"
 #include "config.pb.h"
 #include "controller.h"
+#include "document_cache.h"
 #include "server_clustering.h"
 #include "util.h"
 
@@ -69,7 +71,9 @@ namespace {
             .setMaxConnectionNumPerIP(config.max_connection_num_per_ip())
             .setIdleConnectionTimeout(config.idle_connection_timeout())
             .setKeepaliveRequestsNumber(config.keepalive_requests_number())
-            .setPipeliningRequestsNumber(config.pipelining_requests_number());
+            .setPipeliningRequestsNumber(config.pipelining_requests_number())
+            // Responses are compressed by the handlers, the framework would compress them once again
+            .enableGzip(false);
     }
 
 }
@@ -85,6 +89,13 @@ int RunServer(const std::string& fname, uint16_t port) {
     LOG_DEBUG("Creating annotator");
     std::vector<std::string> languages = {"ru", "en"};
     std::unique_ptr<TAnnotator> annotator = std::make_unique<TAnnotator>(config.annotator_config_path(), languages);
+    std::unique_ptr<TAnnotationExecutor> annotationExecutor = std::make_unique<TAnnotationExecutor>(
+        std::move(annotator),
+        config.annotation_batch_size() != 0 ? config.annotation_batch_size() : 32,
+        std::chrono::microseconds(config.annotation_batch_timeout_us() != 0 ? config.annotation_batch_timeout_us() : 2000),
+        config.annotation_threads() != 0 ? config.annotation_threads() : 2,
+        config.annotation_queue_size() != 0 ? config.annotation_queue_size() : 1024
+    );
 
     LOG_DEBUG("Creating clusterer");
     std::unique_ptr<TClusterer> clusterer = std::make_unique<TClusterer>(config.clusterer_config_path());
@@ -95,7 +106,24 @@ int RunServer(const std::string& fname, uint16_t port) {
     LOG_DEBUG("Creating ranker");
     std::unique_ptr<TRanker> ranker = std::make_unique<TRanker>(config.ranker_config_path());
 
-    TServerClustering serverClustering(std::move(clusterer), std::move(summarizer), db.get());
+    std::unique_ptr<TThreadsResponseCache> threadsCache = std::make_unique<TThreadsResponseCache>(config.gzip_threads_responses());
+    std::unique_ptr<TThreadPool> rankingPool = std::make_unique<TThreadPool>(
+        config.ranking_threads() != 0 ? config.ranking_threads() : 2,
+        config.ranking_queue_size() != 0 ? config.ranking_queue_size() : 256
+    );
+
+    LOG_DEBUG("Loading documents");
+    TDocumentCache cache;
+    TServerClustering serverClustering(
+        std::move(clusterer),
+        std::move(summarizer),
+        std::make_unique<TRanker>(config.ranker_config_path()),
+        db.get(),
+        &cache,
+        config.incremental_clustering(),
+        config.snapshot_path(),
+        std::chrono::seconds(config.snapshot_interval() != 0 ? config.snapshot_interval() : 600)
+    );
 
     LOG_DEBUG("Launching server");
     InitServer(config, port);
@@ -106,8 +134,8 @@ int RunServer(const std::string& fname, uint16_t port) {
     LOG_DEBUG("Launching clustering");
     THotState<TClusterIndex> index;
 
-    auto initContoller = [&, annotator=std::move(annotator)]() mutable {
-        DrClassMap::getSingleInstance<TController>()->Init(&index, db.get(), std::move(annotator), std::move(ranker));
+    auto initContoller = [&, annotationExecutor=std::move(annotationExecutor)]() mutable {
+        DrClassMap::getSingleInstance<TController>()->Init(&index, db.get(), &cache, std::move(annotationExecutor), std::move(ranker), std::move(threadsCache), std::move(rankingPool));
     };
 
     std::thread clusteringThread([&, sleep_ms=config.clusterer_sleep()]() {
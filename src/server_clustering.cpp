@@ -2,71 +2,147 @@
 
 #include "util.h"
 
+#include <boost/filesystem.hpp>
+
+#include <string_view>
+
 TServerClustering::TServerClustering(
     std::unique_ptr<TClusterer> clusterer,
     std::unique_ptr<TSummarizer> summarizer,
-    rocksdb::DB* db
+    std::unique_ptr<TRanker> ranker,
+    rocksdb::DB* db,
+    TDocumentCache* cache,
+    bool incremental,
+    const std::string& snapshotPath,
+    std::chrono::seconds snapshotInterval
 )
     : Clusterer(std::move(clusterer))
     , Summarizer(std::move(summarizer))
+    , Ranker(std::move(ranker))
     , Db(db)
+    , Cache(cache)
+    , Incremental(incremental)
+    , SnapshotPath(snapshotPath)
+    , SnapshotInterval(snapshotInterval)
 {
+    std::unique_ptr<TDocumentSnapshot> snapshot;
+    if (!SnapshotPath.empty() && boost::filesystem::exists(SnapshotPath)) {
+        try {
+            snapshot = std::make_unique<TDocumentSnapshot>(SnapshotPath);
+            LOG_DEBUG("Snapshot loaded: " << snapshot->Size() << " docs");
+        } catch (const std::exception& e) {
+            LOG_ERROR("Snapshot is ignored: " << e.what());
+        }
+    }
+    TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> loadingTimer;
+    LoadDocs(snapshot.get());
+    LOG_DEBUG("Cache loading: " << loadingTimer.Elapsed() << " ms (" << Cache->Size() << " docs)");
 }
 
-namespace {
-
-    std::pair<std::vector<TDbDocument>, uint64_t> ReadDocs(rocksdb::DB* db) {
-        rocksdb::ManagedSnapshot snapshot(db);
+// Documents that are unchanged since the last snapshot are taken from it without protobuf parsing
+void TServerClustering::LoadDocs(const TDocumentSnapshot* docsSnapshot) {
+    rocksdb::ManagedSnapshot snapshot(Db);
 
-        rocksdb::ReadOptions ropt(/*cksum*/ true, /*cache*/ true);
-        ropt.snapshot = snapshot.snapshot();
+    rocksdb::ReadOptions ropt(/*cksum*/ true, /*cache*/ true);
+    ropt.snapshot = snapshot.snapshot();
 
-        std::vector<TDbDocument> docs;
-        uint64_t timestamp = 0;
+    size_t snapshotDocsCount = 0;
+    std::unique_ptr<rocksdb::Iterator> iter(Db->NewIterator(ropt));
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        const rocksdb::Slice value = iter->value();
+        if (value.empty()) {
+            continue;
+        }
 
-        std::unique_ptr<rocksdb::Iterator> iter(db->NewIterator(ropt));
-        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
-            const rocksdb::Slice value = iter->value();
-            if (value.empty()) {
-                continue;
-            }
+        const uint64_t valueHash = TDocumentSnapshot::HashValue(std::string_view(value.data(), value.size()));
+        const std::string_view key(iter->key().data(), iter->key().size());
+        const std::optional<size_t> snapshotIndex = docsSnapshot ? docsSnapshot->Find(key) : std::nullopt;
 
-            TDbDocument doc;
+        TDbDocument doc;
+        if (snapshotIndex && docsSnapshot->GetValueHash(snapshotIndex.value()) == valueHash) {
+            doc = docsSnapshot->GetDocument(snapshotIndex.value());
+            ++snapshotDocsCount;
+        } else {
             const bool succes = TDbDocument::ParseFromArray(value.data(), value.size(), &doc);
             if (!succes) {
                 LOG_DEBUG("Bad document in db: " << iter->key().ToString());
                 continue;
             }
-
-            timestamp = std::max(timestamp, doc.FetchTime);
-            docs.push_back(std::move(doc));
         }
-
-        return std::make_pair(std::move(docs), timestamp);
+        Cache->Put(std::move(doc), valueHash);
     }
+    LOG_DEBUG("Docs from snapshot: " << snapshotDocsCount);
+    UNUSED(snapshotDocsCount);
+}
 
-    void RemoveStaleDocs(rocksdb::DB* db, std::vector<TDbDocument>& docs, uint64_t timestamp) {
-        rocksdb::WriteOptions wopt;
-        for (const auto& doc : docs) {
-            if (doc.IsStale(timestamp)) {
-                db->Delete(wopt, doc.FileName);
-                LOG_DEBUG("Removed: " << doc.FileName);
-            }
+size_t TServerClustering::RemoveStaleDocs(std::vector<TDbDocumentPtr>& docs, uint64_t timestamp) {
+    // A document provided again by a handler is a new one, it is not removed
+    rocksdb::WriteOptions wopt;
+    size_t removedCount = 0;
+    for (const auto& doc : docs) {
+        if (!doc->IsStale(timestamp)) {
+            continue;
+        }
+        const bool removed = Cache->DeleteIf(doc, [&] {
+            Db->Delete(wopt, doc->FileName);
+            return true;
+        });
+        if (removed) {
+            ++removedCount;
+            LOG_DEBUG("Removed: " << doc->FileName);
         }
-        docs.erase(std::remove_if(docs.begin(), docs.end(), [timestamp] (const auto& doc) { return doc.IsStale(timestamp); }), docs.end());
     }
-
+    docs.erase(std::remove_if(docs.begin(), docs.end(), [timestamp] (const auto& doc) { return doc->IsStale(timestamp); }), docs.end());
+    return removedCount;
 }
 
-TClusterIndex TServerClustering::MakeIndex() const {
-    auto [docs, timestamp] = ReadDocs(Db);
+TClusterIndex TServerClustering::MakeIndex() {
+    const uint64_t cacheVersion = Cache->GetVersion();
+    const bool needSnapshot = !SnapshotPath.empty()
+        && SnapshotCacheVersion != cacheVersion
+        && SnapshotTimer.Elapsed() >= SnapshotInterval.count();
+    TDocumentCache::TValueHashes valueHashes;
+    std::vector<TDbDocumentPtr> docs = Cache->GetDocuments(needSnapshot ? &valueHashes : nullptr);
+    uint64_t timestamp = 0;
+    for (const TDbDocumentPtr& doc : docs) {
+        timestamp = std::max(timestamp, doc->FetchTime);
+    }
     LOG_DEBUG("Read " << docs.size() << " docs; timestamp: " << timestamp);
-    RemoveStaleDocs(Db, docs, timestamp);
-
-    TClusterIndex index = Clusterer->Cluster(std::move(docs));
+    // Own removals are already reflected in the documents, so they do not make the snapshot outdated
+    const size_t removedCount = RemoveStaleDocs(docs, timestamp);
+
+    if (needSnapshot) {
+        // A failed write is also retried only after the interval
+        SnapshotTimer.Reset();
+        TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> snapshotTimer;
+        try {
+            TDocumentSnapshot::Write(SnapshotPath, docs, valueHashes);
+            SnapshotCacheVersion = cacheVersion + removedCount;
+        } catch (const std::exception& e) {
+            LOG_ERROR("Snapshot is not updated: " << e.what());
+        }
+        LOG_DEBUG("Snapshot: " << snapshotTimer.Elapsed() << " ms");
+    }
 
-    for (auto& [lang, clusters] : index.Clusters) {
-        Summarizer->Summarize(clusters);
+    TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> clusteringTimer;
+    TClusterIndex index = Clusterer->Cluster(std::move(docs), Incremental ? &ClustererState : nullptr);
+    index.Generation = ++Generation;
+    LOG_DEBUG("Clustering: " << clusteringTimer.Elapsed() << " ms");
+
+    TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> summarizationTimer;
+    Summarizer->Summarize(index.Clusters);
+    LOG_DEBUG("Summarization: " << summarizationTimer.Elapsed() << " ms");
+
+    TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> rankingTimer;
+    const std::vector<uint64_t> periodBuckets = Ranker->GetPeriodBuckets();
+    for (const auto& [lang, clusters] : index.Clusters) {
+        auto& langTops = index.Tops[lang];
+        for (uint64_t period : periodBuckets) {
+            langTops[period] = Ranker->RankPeriod(clusters, index.IterTimestamp, index.TrueMaxTimestamp, period);
+        }
+    }
+    LOG_DEBUG("Ranking: " << rankingTimer.Elapsed() << " ms");
+    for (const auto& [lang, clusters] : index.Clusters) {
         LOG_DEBUG("Clustering output: " << ToString(lang) << " " << clusters.size() << " clusters");
     }
 
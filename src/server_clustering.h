@@ -1,22 +1,50 @@
 #pragma once
 
 #include "clusterer.h"
+#include "document_cache.h"
+#include "document_snapshot.h"
+#include "ranker.h"
 #include "summarizer.h"
+#include "timer.h"
 
 #include <rocksdb/db.h>
 
+#include <chrono>
+#include <optional>
+
 class TServerClustering {
 public:
+    // Cache is filled from the database (and the snapshot if it exists) at construction
     TServerClustering(
         std::unique_ptr<TClusterer> clusterer,
         std::unique_ptr<TSummarizer> summarizer,
-        rocksdb::DB* db
+        std::unique_ptr<TRanker> ranker,
+        rocksdb::DB* db,
+        TDocumentCache* cache,
+        bool incremental = false,
+        const std::string& snapshotPath = "",
+        std::chrono::seconds snapshotInterval = std::chrono::seconds(600)
     );
 
-    TClusterIndex MakeIndex() const;
+    TClusterIndex MakeIndex();
+
+private:
+    void LoadDocs(const TDocumentSnapshot* docsSnapshot);
+    // Returns the number of documents removed from the cache
+    size_t RemoveStaleDocs(std::vector<TDbDocumentPtr>& docs, uint64_t timestamp);
 
 private:
     const std::unique_ptr<TClusterer> Clusterer;
     const std::unique_ptr<TSummarizer> Summarizer;
+    const std::unique_ptr<TRanker> Ranker;
+    uint64_t Generation = 0;
     rocksdb::DB* Db;
+    TDocumentCache* Cache;
+    const bool Incremental = false;
+    TClustererState ClustererState;
+    const std::string SnapshotPath;
+    // Rewriting the whole snapshot is costly, so it is done at most once per interval
+    const std::chrono::seconds SnapshotInterval;
+    TTimer<std::chrono::steady_clock, std::chrono::seconds> SnapshotTimer;
+    std::optional<uint64_t> SnapshotCacheVersion;
 };
@@ -1,8 +1,11 @@
 #include "summarizer.h"
 
+#include "timer.h"
 #include "util.h"
 
-TSummarizer::TSummarizer(const std::string& configPath) {
+TSummarizer::TSummarizer(const std::string& configPath)
+    : ThreadPool(std::make_unique<TWorkStealingPool>())
+{
     ::ParseConfig(configPath, Config);
 
     // Load agency ratings
@@ -17,6 +20,9 @@ TSummarizer::TSummarizer(const std::string& configPath) {
 
 }
 
+// Small clusters are cheap, so they are summarized in chunks
+static constexpr size_t SUMMARIZATION_GRAIN_SIZE = 8;
+
 void TSummarizer::Summarize(TClusters& clusters) const {
     for (TNewsCluster& cluster: clusters) {
         assert(cluster.GetSize() > 0);
@@ -26,4 +32,19 @@ void TSummarizer::Summarize(TClusters& clusters) const {
     }
 }
 
-
+void TSummarizer::Summarize(std::unordered_map<tg::ELanguage, TClusters>& langClusters) const {
+    // Clusters share no state, so clusters of all languages are summarized in one parallel loop
+    std::vector<TNewsCluster*> allClusters;
+    for (auto& [language, clusters] : langClusters) {
+        for (TNewsCluster& cluster : clusters) {
+            allClusters.push_back(&cluster);
+        }
+    }
+    ThreadPool->ParallelFor(0, allClusters.size(), [this, &allClusters](size_t i) {
+        TNewsCluster& cluster = *allClusters[i];
+        assert(cluster.GetSize() > 0);
+        cluster.Summarize(AgencyRating);
+        cluster.CalcImportance(AlexaAgencyRating);
+        cluster.CalcCategory();
+    }, SUMMARIZATION_GRAIN_SIZE);
+}
@@ -3,15 +3,21 @@
 #include "agency_rating.h"
 #include "cluster.h"
 #include "config.pb.h"
+#include "work_stealing_pool.h"
+
+#include <memory>
 
 class TSummarizer {
 public:
     TSummarizer(const std::string& configPath);
 
     void Summarize(TClusters& clusters) const;
+    void Summarize(std::unordered_map<tg::ELanguage, TClusters>& langClusters) const;
 
 private:
     tg::TSummarizerConfig Config;
     TAgencyRating AgencyRating;
     TAlexaAgencyRating AlexaAgencyRating;
+    // Created once for all iterations
+    std::unique_ptr<TWorkStealingPool> ThreadPool;
 };
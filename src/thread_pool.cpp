@@ -24,7 +24,9 @@
 #include "thread_pool.h"
 
 
-TThreadPool::TThreadPool(size_t threadsCount) {
+TThreadPool::TThreadPool(size_t threadsCount, size_t maxQueueSize)
+    : MaxQueueSize(maxQueueSize)
+{
     for (size_t i = 0;i < threadsCount; ++i) {
         Threads.emplace_back(
             [this] {
@@ -46,6 +48,21 @@ TThreadPool::TThreadPool(size_t threadsCount) {
     }
 }
 
+bool TThreadPool::tryEnqueue(std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        if (IsDone) {
+            throw std::runtime_error("enqueue on stopped TThreadPool");
+        }
+        if (MaxQueueSize != 0 && Tasks.size() >= MaxQueueSize) {
+            return false;
+        }
+        Tasks.emplace(std::move(task));
+    }
+    Condition.notify_one();
+    return true;
+}
+
 TThreadPool::~TThreadPool() {
     {
         std::unique_lock<std::mutex> lock(Mutex);
@@ -35,13 +35,17 @@
 class TThreadPool {
 public:
     // The constructor just launches some amount of workers
-    TThreadPool(size_t threadsCount=std::thread::hardware_concurrency());
+    // Zero maxQueueSize means no limit for tryEnqueue
+    TThreadPool(size_t threadsCount=std::thread::hardware_concurrency(), size_t maxQueueSize=0);
 
     // Add new work item to the pool
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
 
+    // Add new work item if the queue is not full, returns false otherwise
+    bool tryEnqueue(std::function<void()> task);
+
     // The destructor joins all threads
     ~TThreadPool();
 
@@ -50,6 +54,7 @@ private:
     std::vector<std::thread> Threads;
     // The task queue
     std::queue<std::function<void()>> Tasks;
+    const size_t MaxQueueSize = 0;
 
     // Synchronization
     std::mutex Mutex;
@@ -0,0 +1,60 @@
+#include "token_stream.h"
+
+#include <cassert>
+
+void TTokenStream::AddField(const std::vector<std::string>& tokens) {
+    FieldBegins.push_back(TokenBegins.size());
+    if (tokens.empty()) {
+        if (!TokenBegins.empty()) {
+            Buffer.push_back(' ');
+        }
+        TokenBegins.push_back(Buffer.size());
+        return;
+    }
+    for (const std::string& token : tokens) {
+        assert(token.find(' ') == std::string::npos);
+        if (!TokenBegins.empty()) {
+            Buffer.push_back(' ');
+        }
+        TokenBegins.push_back(Buffer.size());
+        Buffer.append(token);
+    }
+}
+
+size_t TTokenStream::GetTokenEnd(size_t index) const {
+    // The next token starts right after a separator
+    return index + 1 < TokenBegins.size() ? TokenBegins[index + 1] - 1 : Buffer.size();
+}
+
+std::string_view TTokenStream::GetToken(size_t index) const {
+    assert(index < Size());
+    const size_t begin = TokenBegins[index];
+    return std::string_view(Buffer).substr(begin, GetTokenEnd(index) - begin);
+}
+
+TTokenSpan TTokenStream::GetFields(size_t begin, size_t end) const {
+    assert(begin <= end && end <= GetFieldsCount());
+    const size_t tokensBegin = begin < FieldBegins.size() ? FieldBegins[begin] : Size();
+    const size_t tokensEnd = end < FieldBegins.size() ? FieldBegins[end] : Size();
+    return TTokenSpan(*this, tokensBegin, tokensEnd);
+}
+
+TTokenSpan TTokenStream::GetAll() const {
+    return TTokenSpan(*this, 0, Size());
+}
+
+TTokenSpan::TTokenSpan(const TTokenStream& stream, size_t begin, size_t end)
+    : Stream(&stream)
+    , Begin(begin)
+    , End(end)
+{
+    assert(begin <= end && end <= stream.Size());
+}
+
+std::string_view TTokenSpan::GetText() const {
+    if (Empty()) {
+        return std::string_view();
+    }
+    const size_t begin = Stream->TokenBegins[Begin];
+    return std::string_view(Stream->Buffer).substr(begin, Stream->GetTokenEnd(End - 1) - begin);
+}
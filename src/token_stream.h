@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TTokenSpan;
+
+// Tokens of one or more fields in a single buffer with the token offsets.
+// Tokens and fields are separated by single spaces, so the buffer is the same as the tokens joined with spaces.
+// A field without tokens is stored as one empty token, the same way the joined string is split on spaces.
+class TTokenStream {
+public:
+    // Tokens should not contain spaces, as the ones of onmt::Tokenizer
+    void AddField(const std::vector<std::string>& tokens);
+
+    size_t Size() const { return TokenBegins.size(); }
+    size_t GetFieldsCount() const { return FieldBegins.size(); }
+    std::string_view GetToken(size_t index) const;
+    const std::string& GetText() const { return Buffer; }
+
+    // Tokens of the fields [begin, end)
+    TTokenSpan GetFields(size_t begin, size_t end) const;
+    TTokenSpan GetAll() const;
+
+private:
+    size_t GetTokenEnd(size_t index) const;
+
+private:
+    friend class TTokenSpan;
+
+    std::string Buffer;
+    std::vector<size_t> TokenBegins;
+    std::vector<size_t> FieldBegins;
+};
+
+// Consecutive tokens of a stream, valid while the stream is alive
+class TTokenSpan {
+public:
+    TTokenSpan(const TTokenStream& stream, size_t begin, size_t end);
+
+    size_t Size() const { return End - Begin; }
+    bool Empty() const { return Begin == End; }
+    std::string_view operator[](size_t index) const { return Stream->GetToken(Begin + index); }
+
+    // The tokens joined with spaces
+    std::string_view GetText() const;
+
+private:
+    const TTokenStream* Stream;
+    size_t Begin;
+    size_t End;
+};
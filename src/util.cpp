@@ -1,4 +1,6 @@
+#include <cctype>
 #include <cmath>
+#include <cstdio>
 #include <ctime>
 #include <regex>
 
@@ -11,12 +13,13 @@ void ReadFileNames(const std::string& directory, std::vector<std::string>& fileN
     boost::filesystem::recursive_directory_iterator start(dirPath);
     boost::filesystem::recursive_directory_iterator end;
     for (auto it = start; it != end; it++) {
-        if (boost::filesystem::is_directory(it->path())) {
+        // The entry status comes from the directory listing, so no stat call is made per file
+        if (boost::filesystem::is_directory(it->status())) {
             continue;
         }
         std::string path = it->path().string();
-        if (path.substr(path.length() - 5) == ".html") {
-            fileNames.push_back(path);
+        if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".html") == 0) {
+            fileNames.push_back(std::move(path));
         }
         if (nDocs != -1 && fileNames.size() == static_cast<size_t>(nDocs)) {
             break;
@@ -64,27 +67,70 @@ double Sigmoid(double x) {
     return z / (1.0 + z);
 }
 
+size_t CountWords(std::string_view text) {
+    size_t count = 0;
+    bool inWord = false;
+    for (const char c : text) {
+        const bool isSpace = std::isspace(static_cast<unsigned char>(c));
+        count += !isSpace && !inWord;
+        inWord = !isSpace;
+    }
+    return count;
+}
+
 uint64_t DateToTimestamp(const std::string& date) {
-    std::regex ex("(\\d\\d\\d\\d)-(\\d\\d)-(\\d\\d)T(\\d\\d):(\\d\\d):(\\d\\d)([+-])(\\d\\d):(\\d\\d)");
-    std::smatch what;
-    if (!std::regex_match(date, what, ex) || what.size() < 10) {
+    // YYYY-MM-DDTHH:MM:SS+HH:MM, 'd' is a digit and '+' is a zone sign
+    static constexpr std::string_view layout = "dddd-dd-ddTdd:dd:dd+dd:dd";
+    bool isValid = date.size() == layout.size();
+    for (size_t i = 0; isValid && i < layout.size(); i++) {
+        const char c = date[i];
+        if (layout[i] == 'd') {
+            isValid = c >= '0' && c <= '9';
+        } else if (layout[i] == '+') {
+            isValid = c == '+' || c == '-';
+        } else {
+            isValid = c == layout[i];
+        }
+    }
+    if (!isValid) {
         throw std::runtime_error("wrong date format");
     }
+    const auto number = [&date](size_t begin, size_t length) {
+        int value = 0;
+        for (size_t i = begin; i < begin + length; i++) {
+            value = value * 10 + (date[i] - '0');
+        }
+        return value;
+    };
     std::tm t = {};
-    t.tm_sec = std::stoi(what[6]);
-    t.tm_min = std::stoi(what[5]);
-    t.tm_hour = std::stoi(what[4]);
-    t.tm_mday = std::stoi(what[3]);
-    t.tm_mon = std::stoi(what[2]) - 1;
-    t.tm_year = std::stoi(what[1]) - 1900;
+    t.tm_sec = number(17, 2);
+    t.tm_min = number(14, 2);
+    t.tm_hour = number(11, 2);
+    t.tm_mday = number(8, 2);
+    t.tm_mon = number(5, 2) - 1;
+    t.tm_year = number(0, 4) - 1900;
 
     time_t timestamp = timegm(&t);
-    uint64_t zone_ts = std::stoi(what[8]) * 60 * 60 + std::stoi(what[9]) * 60;
-    if (what[7] == "+") {
+    uint64_t zone_ts = number(20, 2) * 60 * 60 + number(23, 2) * 60;
+    if (date[19] == '+') {
         timestamp = timestamp - zone_ts;
-    } else if (what[7] == "-") {
+    } else {
         timestamp = timestamp + zone_ts;
     }
     return timestamp > 0 ? timestamp : 0;
 }
 
+void WriteFileAtomically(const std::string& path, const std::function<void(std::ofstream&)>& write) {
+    const std::string tmpPath = path + ".tmp";
+    try {
+        std::ofstream stream(tmpPath, std::ios::binary | std::ios::trunc);
+        ENSURE(stream.is_open(), "Could not open " << tmpPath);
+        write(stream);
+        stream.close();
+        ENSURE(stream.good(), "Could not write " << tmpPath);
+    } catch (...) {
+        std::remove(tmpPath.c_str());
+        throw;
+    }
+    ENSURE(std::rename(tmpPath.c_str(), path.c_str()) == 0, "Could not rename " << tmpPath << " to " << path);
+}
@@ -7,7 +7,10 @@
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <nlohmann_json/json.hpp>
 
+#include <fstream>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
 #include <iostream>
@@ -53,6 +56,13 @@ NLOHMANN_JSON_SERIALIZE_ENUM(tg::ECategory, {
     {tg::NC_NOT_NEWS, "not_news"},
 })
 
+NLOHMANN_JSON_SERIALIZE_ENUM(tg::EOutputFormat, {
+    {tg::OF_UNDEFINED, nullptr},
+    {tg::OF_PRETTY, "pretty"},
+    {tg::OF_COMPACT, "compact"},
+    {tg::OF_NDJSON, "ndjson"},
+})
+
 }
 
 template<typename T, typename = typename std::enable_if<std::is_enum<T>::value, T>::type>
@@ -78,9 +88,15 @@ std::string CleanFileName(const std::string& fileName);
 float Sigmoid(float x);
 double Sigmoid(double x);
 
+// Number of whitespace separated words, same as reading them with operator>>
+size_t CountWords(std::string_view text);
+
 // ISO 8601 with timezone date to timestamp
 uint64_t DateToTimestamp(const std::string& date);
 
+// Writes the file through a temporary one renamed at the end, so readers never see a partial file
+void WriteFileAtomically(const std::string& path, const std::function<void(std::ofstream&)>& write);
+
 template <class TConfig>
 void ParseConfig(const std::string& fname, TConfig& config) {
     const int fileDesc = open(fname.c_str(), O_RDONLY);
@@ -0,0 +1,88 @@
+#include "work_stealing_pool.h"
+
+thread_local const TWorkStealingPool* TWorkStealingPool::CurrentPool = nullptr;
+thread_local size_t TWorkStealingPool::CurrentWorker = 0;
+
+TWorkStealingPool::TWorkStealingPool(size_t threadsCount) {
+    threadsCount = std::max(threadsCount, static_cast<size_t>(1));
+    Workers.reserve(threadsCount);
+    for (size_t i = 0; i < threadsCount; ++i) {
+        Workers.push_back(std::make_unique<TWorker>());
+    }
+    Threads.reserve(threadsCount);
+    for (size_t i = 0; i < threadsCount; ++i) {
+        Threads.emplace_back(&TWorkStealingPool::Work, this, i);
+    }
+}
+
+TWorkStealingPool::~TWorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex);
+        IsDone = true;
+    }
+    SleepCondition.notify_all();
+    for (std::thread& thread : Threads) {
+        thread.join();
+    }
+}
+
+void TWorkStealingPool::Push(TTask&& task) {
+    const size_t workerIndex = CurrentPool == this
+        ? CurrentWorker
+        : NextWorker.fetch_add(1, std::memory_order_relaxed) % Workers.size();
+    {
+        TWorker& worker = *Workers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.Mutex);
+        worker.Tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex);
+        ++PendingTasks;
+    }
+    SleepCondition.notify_one();
+}
+
+bool TWorkStealingPool::TryPop(size_t workerIndex, TTask* task) {
+    for (size_t i = 0; i < Workers.size(); ++i) {
+        TWorker& worker = *Workers[(workerIndex + i) % Workers.size()];
+        std::lock_guard<std::mutex> lock(worker.Mutex);
+        if (worker.Tasks.empty()) {
+            continue;
+        }
+        // The owner takes the most recent task, thieves take the oldest one
+        if (i == 0) {
+            *task = std::move(worker.Tasks.back());
+            worker.Tasks.pop_back();
+        } else {
+            *task = std::move(worker.Tasks.front());
+            worker.Tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void TWorkStealingPool::Work(size_t workerIndex) {
+    CurrentPool = this;
+    CurrentWorker = workerIndex;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(SleepMutex);
+            SleepCondition.wait(lock, [this] { return IsDone || PendingTasks != 0; });
+            if (PendingTasks == 0) {
+                return;
+            }
+        }
+        TTask task;
+        if (!TryPop(workerIndex, &task)) {
+            // Another worker has taken the task between the wake up and the pop
+            std::this_thread::yield();
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(SleepMutex);
+            --PendingTasks;
+        }
+        task();
+    }
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Thread pool with a task deque per worker. Workers pop their own tasks from the back and steal
+// from the front of the other deques. Small tasks are stored inline without allocations.
+class TWorkStealingPool {
+public:
+    explicit TWorkStealingPool(size_t threadsCount = std::thread::hardware_concurrency());
+    ~TWorkStealingPool();
+
+    TWorkStealingPool(const TWorkStealingPool&) = delete;
+    TWorkStealingPool& operator=(const TWorkStealingPool&) = delete;
+
+    // Fire and forget, exceptions must not escape the task
+    template<class F>
+    void Submit(F&& f);
+
+    // Calls body(i) for every i in [begin, end) and blocks until all calls are finished.
+    // Indices are claimed in chunks of grainSize, the calling thread processes chunks too.
+    // The first exception thrown by the body is rethrown, the remaining chunks are skipped.
+    template<class F>
+    void ParallelFor(size_t begin, size_t end, F&& body, size_t grainSize = 1);
+
+    size_t GetThreadsCount() const { return Threads.size(); }
+
+private:
+    class TTask {
+    public:
+        TTask() = default;
+
+        template<class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, TTask>>>
+        explicit TTask(F&& f) {
+            using TFunc = std::decay_t<F>;
+            if constexpr (IsInline<TFunc>()) {
+                new (&Buffer) TFunc(std::forward<F>(f));
+                Ops = &InlineOps<TFunc>;
+            } else {
+                new (&Buffer) TFunc*(new TFunc(std::forward<F>(f)));
+                Ops = &HeapOps<TFunc>;
+            }
+        }
+
+        TTask(TTask&& other) noexcept {
+            MoveFrom(std::move(other));
+        }
+
+        TTask& operator=(TTask&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                MoveFrom(std::move(other));
+            }
+            return *this;
+        }
+
+        ~TTask() {
+            Reset();
+        }
+
+        void operator()() {
+            Ops->Invoke(&Buffer);
+        }
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 48;
+
+        struct TOps {
+            void (*Invoke)(void*);
+            void (*Move)(void*, void*);
+            void (*Destroy)(void*);
+        };
+
+        template<class TFunc>
+        static constexpr bool IsInline() {
+            return sizeof(TFunc) <= BUFFER_SIZE
+                && alignof(TFunc) <= alignof(std::max_align_t)
+                && std::is_nothrow_move_constructible_v<TFunc>;
+        }
+
+        template<class TFunc>
+        static constexpr TOps InlineOps = {
+            [](void* buffer) { (*static_cast<TFunc*>(buffer))(); },
+            [](void* from, void* to) {
+                new (to) TFunc(std::move(*static_cast<TFunc*>(from)));
+                static_cast<TFunc*>(from)->~TFunc();
+            },
+            [](void* buffer) { static_cast<TFunc*>(buffer)->~TFunc(); }
+        };
+
+        template<class TFunc>
+        static constexpr TOps HeapOps = {
+            [](void* buffer) { (**static_cast<TFunc**>(buffer))(); },
+            [](void* from, void* to) { new (to) TFunc*(*static_cast<TFunc**>(from)); },
+            [](void* buffer) { delete *static_cast<TFunc**>(buffer); }
+        };
+
+        void MoveFrom(TTask&& other) {
+            Ops = other.Ops;
+            if (Ops) {
+                Ops->Move(&other.Buffer, &Buffer);
+                other.Ops = nullptr;
+            }
+        }
+
+        void Reset() {
+            if (Ops) {
+                Ops->Destroy(&Buffer);
+                Ops = nullptr;
+            }
+        }
+
+    private:
+        alignas(std::max_align_t) unsigned char Buffer[BUFFER_SIZE];
+        const TOps* Ops = nullptr;
+    };
+
+    struct TWorker {
+        std::mutex Mutex;
+        std::deque<TTask> Tasks;
+    };
+
+    template<class F>
+    struct TParallelForState {
+        F* Body = nullptr;
+        size_t End = 0;
+        size_t GrainSize = 1;
+        size_t Total = 0;
+        std::atomic<size_t> Next {0};
+
+        std::mutex Mutex;
+        std::condition_variable Condition;
+        size_t Done = 0;
+        std::exception_ptr Error;
+
+        // Returns false if there are no more chunks
+        bool RunChunk();
+    };
+
+    void Push(TTask&& task);
+    bool TryPop(size_t workerIndex, TTask* task);
+    void Work(size_t workerIndex);
+
+private:
+    std::vector<std::unique_ptr<TWorker>> Workers;
+    std::vector<std::thread> Threads;
+    std::atomic<size_t> NextWorker {0};
+
+    std::mutex SleepMutex;
+    std::condition_variable SleepCondition;
+    size_t PendingTasks = 0;
+    bool IsDone = false;
+
+    // Tasks submitted from a worker go to its own deque
+    static thread_local const TWorkStealingPool* CurrentPool;
+    static thread_local size_t CurrentWorker;
+};
+
+template<class F>
+void TWorkStealingPool::Submit(F&& f) {
+    Push(TTask(std::forward<F>(f)));
+}
+
+template<class F>
+bool TWorkStealingPool::TParallelForState<F>::RunChunk() {
+    const size_t from = Next.fetch_add(GrainSize, std::memory_order_relaxed);
+    if (from >= End) {
+        return false;
+    }
+    const size_t to = std::min(from + GrainSize, End);
+    try {
+        for (size_t i = from; i < to; ++i) {
+            (*Body)(i);
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (!Error) {
+            Error = std::current_exception();
+        }
+    }
+    std::lock_guard<std::mutex> lock(Mutex);
+    Done += to - from;
+    if (Error) {
+        // Skipped chunks are counted as done, so the caller wakes up
+        const size_t skippedFrom = std::min(Next.exchange(End, std::memory_order_relaxed), End);
+        Done += End - skippedFrom;
+    }
+    if (Done == Total) {
+        Condition.notify_all();
+    }
+    return true;
+}
+
+template<class F>
+void TWorkStealingPool::ParallelFor(size_t begin, size_t end, F&& body, size_t grainSize) {
+    if (begin >= end) {
+        return;
+    }
+    using TBody = std::remove_reference_t<F>;
+    // Helpers keep the state alive, they may start after the loop is finished
+    auto state = std::make_shared<TParallelForState<TBody>>();
+    state->Body = &body;
+    state->End = end;
+    state->GrainSize = std::max(grainSize, static_cast<size_t>(1));
+    state->Total = end - begin;
+    state->Next.store(begin, std::memory_order_relaxed);
+
+    const size_t chunksCount = (state->Total + state->GrainSize - 1) / state->GrainSize;
+    const size_t helpersCount = std::min(Threads.size(), chunksCount - 1);
+    for (size_t i = 0; i < helpersCount; ++i) {
+        Submit([state]() {
+            while (state->RunChunk()) {}
+        });
+    }
+    while (state->RunChunk()) {}
+
+    std::unique_lock<std::mutex> lock(state->Mutex);
+    state->Condition.wait(lock, [&state] { return state->Done == state->Total; });
+    if (state->Error) {
+        std::rethrow_exception(state->Error);
+    }
+}
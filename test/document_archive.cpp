@@ -0,0 +1,145 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "DocumentArchiveModule"
+
+#include "../src/document_archive.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+class TTempDir {
+public:
+    TTempDir()
+        : Path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    {
+        boost::filesystem::create_directories(Path);
+    }
+
+    ~TTempDir() {
+        boost::filesystem::remove_all(Path);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) const {
+        const std::string path = GetPath(name);
+        std::ofstream(path, std::ios::binary) << content;
+        return path;
+    }
+
+    std::string GetPath(const std::string& name) const {
+        return (Path / name).string();
+    }
+
+private:
+    boost::filesystem::path Path;
+};
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+// Header fields are at fixed offsets: magic, version, reserved, docs count, entries offset, file size
+constexpr size_t DOCS_COUNT_OFFSET = 16;
+constexpr size_t ENTRIES_OFFSET_OFFSET = 24;
+
+uint64_t ReadUint64(const std::string& data, size_t offset) {
+    uint64_t value = 0;
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+}
+
+void WriteUint64(std::string& data, size_t offset, uint64_t value) {
+    std::memcpy(&data[offset], &value, sizeof(value));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( pack_and_read )
+{
+    TTempDir dir;
+    const std::vector<std::string> contents = {"<html>first</html>", "", std::string(10000, 'x') + std::string("\n\0tail", 6)};
+    std::vector<std::string> fileNames;
+    for (size_t i = 0; i < contents.size(); ++i) {
+        fileNames.push_back(dir.Write(std::to_string(i) + ".html", contents[i]));
+    }
+    // Unreadable files are skipped
+    fileNames.insert(fileNames.begin() + 1, dir.GetPath("missing.html"));
+
+    const std::string archivePath = dir.GetPath("data.tgar");
+    BOOST_CHECK_EQUAL(TDocumentArchive::Pack(archivePath, fileNames), contents.size());
+    BOOST_CHECK(!boost::filesystem::exists(archivePath + ".tmp"));
+
+    const TDocumentArchive archive(archivePath);
+    BOOST_REQUIRE_EQUAL(archive.Size(), contents.size());
+    for (size_t i = 0; i < contents.size(); ++i) {
+        BOOST_CHECK_EQUAL(archive.GetName(i), dir.GetPath(std::to_string(i) + ".html"));
+        BOOST_CHECK_EQUAL(archive.GetData(i), contents[i]);
+    }
+    archive.Prefetch(0, archive.Size());
+    archive.Prefetch(1, 1);
+
+    const std::string emptyPath = dir.GetPath("empty.tgar");
+    BOOST_CHECK_EQUAL(TDocumentArchive::Pack(emptyPath, {}), 0);
+    BOOST_CHECK_EQUAL(TDocumentArchive(emptyPath).Size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( bad_archives )
+{
+    TTempDir dir;
+    const std::string archivePath = dir.GetPath("data.tgar");
+    TDocumentArchive::Pack(archivePath, {dir.Write("0.html", "<html>0</html>"), dir.Write("1.html", "<html>1</html>")});
+    const std::string data = ReadFile(archivePath);
+
+    const auto checkBad = [&dir](const std::string& content) {
+        BOOST_CHECK_THROW(TDocumentArchive(dir.Write("bad.tgar", content)), std::runtime_error);
+    };
+
+    // Truncated header and truncated data
+    checkBad("");
+    checkBad(data.substr(0, 20));
+    checkBad(data.substr(0, data.size() - 1));
+
+    std::string badMagic = data;
+    badMagic[0] = 'X';
+    checkBad(badMagic);
+
+    std::string badVersion = data;
+    badVersion[8] = 100;
+    checkBad(badVersion);
+
+    std::string badDocsCount = data;
+    WriteUint64(badDocsCount, DOCS_COUNT_OFFSET, 1000);
+    checkBad(badDocsCount);
+
+    std::string badEntriesOffset = data;
+    WriteUint64(badEntriesOffset, ENTRIES_OFFSET_OFFSET, data.size() + 1);
+    checkBad(badEntriesOffset);
+
+    // The data of the last document goes over the entry table
+    std::string badEntry = data;
+    const uint64_t entriesOffset = ReadUint64(data, ENTRIES_OFFSET_OFFSET);
+    WriteUint64(badEntry, entriesOffset + 3 * sizeof(uint64_t) + 2 * sizeof(uint64_t), 1000);
+    checkBad(badEntry);
+
+    // Documents in the reversed order, each one is in bounds
+    std::string badOrder = data;
+    std::memcpy(&badOrder[entriesOffset], data.data() + entriesOffset + 3 * sizeof(uint64_t), 3 * sizeof(uint64_t));
+    std::memcpy(&badOrder[entriesOffset + 3 * sizeof(uint64_t)], data.data() + entriesOffset, 3 * sizeof(uint64_t));
+    checkBad(badOrder);
+
+    // Overlapping documents
+    std::string badOverlap = data;
+    WriteUint64(badOverlap, entriesOffset + 3 * sizeof(uint64_t), ReadUint64(data, entriesOffset));
+    checkBad(badOverlap);
+
+    BOOST_CHECK_THROW(TDocumentArchive(dir.GetPath("missing.tgar")), std::runtime_error);
+}
@@ -0,0 +1,51 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "DocumentArenaModule"
+
+#include "../src/document_arena.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE( embeddings_moved_out )
+{
+    std::vector<TDbDocument> docs(3);
+    for (size_t i = 0; i < docs.size(); ++i) {
+        docs[i].FileName = std::to_string(i) + ".html";
+        docs[i].Host = "host" + std::to_string(i);
+        docs[i].Embeddings[tg::EK_FASTTEXT_CLASSIC] = std::vector<float>{3.0f * i, 4.0f * i};
+    }
+    const TDocumentArena arena(std::move(docs));
+
+    BOOST_CHECK_EQUAL(arena.Size(), 3);
+    // Owned documents give their embeddings to the matrices
+    for (const TDbDocumentPtr& doc : arena.GetDocuments()) {
+        BOOST_CHECK(doc->Embeddings.empty());
+    }
+
+    const TEmbeddingMatrix& embeddings = arena.GetEmbeddings(tg::EK_FASTTEXT_CLASSIC);
+    BOOST_CHECK_EQUAL(embeddings.GetRows(), 3);
+    BOOST_CHECK_EQUAL(embeddings.GetCols(), 2);
+    BOOST_CHECK(embeddings.IsBadRow(0));
+    for (size_t i = 1; i < arena.Size(); ++i) {
+        BOOST_CHECK(!embeddings.IsBadRow(i));
+        BOOST_CHECK_CLOSE(embeddings.GetMatrix()(i, 0), 0.6f, 0.001f);
+        BOOST_CHECK_CLOSE(embeddings.GetMatrix()(i, 1), 0.8f, 0.001f);
+    }
+    BOOST_CHECK_THROW(arena.GetEmbeddings(tg::EK_FASTTEXT_TITLE), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( shared_documents_unchanged )
+{
+    auto doc = std::make_shared<TDbDocument>();
+    doc->FileName = "0.html";
+    doc->Embeddings[tg::EK_FASTTEXT_CLASSIC] = std::vector<float>{3.0f, 4.0f};
+    const TDocumentArena arena(std::vector<TDbDocumentPtr>{doc});
+
+    BOOST_CHECK_EQUAL(arena.GetDocuments()[0].get(), doc.get());
+    BOOST_CHECK_EQUAL(doc->Embeddings.at(tg::EK_FASTTEXT_CLASSIC).size(), 2);
+    BOOST_CHECK_CLOSE(arena.GetEmbeddings(tg::EK_FASTTEXT_CLASSIC).GetMatrix()(0, 1), 0.8f, 0.001f);
+}
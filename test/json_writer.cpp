@@ -0,0 +1,80 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "JsonWriterModule"
+
+#include "../src/json_writer.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string WriteArray(const std::vector<nlohmann::json>& elements, tg::EOutputFormat format, const std::string& objectKey = "") {
+    std::ostringstream output;
+    TJsonArrayWriter writer(output, format, objectKey);
+    for (const nlohmann::json& element : elements) {
+        writer.Write(element);
+    }
+    writer.Finish();
+    return output.str();
+}
+
+std::string MakeNdjson(const std::vector<nlohmann::json>& elements) {
+    std::string result;
+    for (const nlohmann::json& element : elements) {
+        result += element.dump() + "\n";
+    }
+    return result;
+}
+
+void CheckAllFormats(const std::vector<nlohmann::json>& elements) {
+    const nlohmann::json array(elements);
+    BOOST_CHECK_EQUAL(WriteArray(elements, tg::OF_PRETTY), array.dump(4) + "\n");
+    BOOST_CHECK_EQUAL(WriteArray(elements, tg::OF_COMPACT), array.dump() + "\n");
+    BOOST_CHECK_EQUAL(WriteArray(elements, tg::OF_NDJSON), MakeNdjson(elements));
+
+    const nlohmann::json wrapped = {{"threads", array}};
+    BOOST_CHECK_EQUAL(WriteArray(elements, tg::OF_PRETTY, "threads"), wrapped.dump(4) + "\n");
+    BOOST_CHECK_EQUAL(WriteArray(elements, tg::OF_COMPACT, "threads"), wrapped.dump() + "\n");
+    // The key is ignored for line-delimited output
+    BOOST_CHECK_EQUAL(WriteArray(elements, tg::OF_NDJSON, "threads"), MakeNdjson(elements));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( empty_array )
+{
+    CheckAllFormats({});
+}
+
+BOOST_AUTO_TEST_CASE( single_element )
+{
+    CheckAllFormats({nlohmann::json{{"title", "Title"}, {"articles", {"1.html", "2.html"}}}});
+    CheckAllFormats({nlohmann::json("text")});
+    CheckAllFormats({nlohmann::json::array()});
+}
+
+BOOST_AUTO_TEST_CASE( nested_elements )
+{
+    // Line breaks inside strings are escaped and must not get the array indent
+    CheckAllFormats({
+        nlohmann::json{{"title", "multi\nline \"text\""}, {"empty", nlohmann::json::object()}},
+        nlohmann::json{{"threads", {{{"articles", {"a.html"}}, {"category", "society"}}, nlohmann::json::array()}}},
+        nlohmann::json(42),
+        nlohmann::json{{"unicode", "Привет"}}
+    });
+}
+
+BOOST_AUTO_TEST_CASE( write_after_finish )
+{
+    std::ostringstream output;
+    TJsonArrayWriter writer(output, tg::OF_COMPACT);
+    writer.Write(nlohmann::json(1));
+    writer.Finish();
+    writer.Finish();
+    BOOST_CHECK_EQUAL(output.str(), "[1]\n");
+    BOOST_CHECK_THROW(writer.Write(nlohmann::json(2)), std::exception);
+}
@@ -8,8 +8,13 @@
 #include "../src/document.h"
 
 #include <boost/test/unit_test.hpp>
+#include <tinyxml2/tinyxml2.h>
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 
 BOOST_AUTO_TEST_CASE( parser )
 {
@@ -26,3 +31,57 @@ BOOST_AUTO_TEST_CASE( parser )
     BOOST_REQUIRE_EQUAL(htmlDocument.Author, jsonDocument.Author);
 }
 
+
+void CheckSameAsDom(const std::string& html) {
+    // The reference is loaded as files were loaded before: LoadFile keeps the elements parsed before an error, Parse drops them
+    std::unique_ptr<FILE, decltype(&std::fclose)> file(std::tmpfile(), &std::fclose);
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(std::fwrite(html.data(), 1, html.size(), file.get()), html.size());
+    std::rewind(file.get());
+    tinyxml2::XMLDocument domHtml;
+    domHtml.LoadFile(file.get());
+    TDocument domDocument;
+    domDocument.FromHtml(domHtml, "doc.html", /* parseLinks */ true);
+
+    TDocument document;
+    document.FromHtmlBuffer(html.data(), html.size(), "doc.html", /* parseLinks */ true);
+
+    BOOST_REQUIRE_EQUAL(document.Title, domDocument.Title);
+    BOOST_REQUIRE_EQUAL(document.Url, domDocument.Url);
+    BOOST_REQUIRE_EQUAL(document.SiteName, domDocument.SiteName);
+    BOOST_REQUIRE_EQUAL(document.Description, domDocument.Description);
+    BOOST_REQUIRE_EQUAL(document.Text, domDocument.Text);
+    BOOST_REQUIRE_EQUAL(document.Author, domDocument.Author);
+    BOOST_REQUIRE_EQUAL(document.PubTime, domDocument.PubTime);
+    BOOST_REQUIRE_EQUAL(document.FetchTime, domDocument.FetchTime);
+    BOOST_REQUIRE(document.OutLinks == domDocument.OutLinks);
+}
+
+BOOST_AUTO_TEST_CASE( html_extractor )
+{
+    std::ifstream fileStream(STR(TEST_PATH)"/data/example1.html");
+    std::stringstream buffer;
+    buffer << fileStream.rdbuf();
+    CheckSameAsDom(buffer.str());
+
+    CheckSameAsDom(
+        "<?xml version=\"1.0\"?><!DOCTYPE html>\r\n<html><head>"
+        "<meta property=\"og:title\" content=\"A &amp; B &#x41;&#66;\"/><meta charset=\"utf-8\"/>"
+        "</head><body><article><h1>Skipped</h1>"
+        "<p>  One <b>two <i>three</i></b><!-- no --> <a href=\"http://x.y/?a=1&amp;b=2\">four</a>\r\n</p>"
+        "<p>&lt;p&gt; &nbsp; <![CDATA[five & six]]><p>nested</p></p><p/>"
+        "<address><time datetime=\"2019-11-01T00:32:00+03:00\">t</time><a rel=\"author\">Author</a></address>"
+        "</article></body></html>\n"
+    );
+
+    // Errors after the html element do not drop it
+    const std::string htmlWithTail =
+        "<html><head><meta property=\"og:title\" content=\"t\"/></head>"
+        "<body><article><p>text</p></article></body></html>";
+    CheckSameAsDom(htmlWithTail + "<p>x</q>");
+    CheckSameAsDom(htmlWithTail + "<!-- unterminated");
+
+    TDocument document;
+    const std::string malformed = "<html><head><meta property=\"og:title\" content=\"t\"/></head><body><article><p>text</article></body></html>";
+    BOOST_CHECK_THROW(document.FromHtmlBuffer(malformed.data(), malformed.size(), "doc.html"), std::runtime_error);
+}
@@ -0,0 +1,93 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "RecordReaderModule"
+
+#include "../src/record_reader.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+class TTempFiles {
+public:
+    ~TTempFiles() {
+        for (const std::string& fileName : FileNames) {
+            boost::filesystem::remove(fileName);
+        }
+    }
+
+    const std::string& Add(const std::string& content) {
+        const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        std::ofstream(path.string(), std::ios::binary) << content;
+        FileNames.push_back(path.string());
+        return FileNames.back();
+    }
+
+    const std::vector<std::string>& GetFileNames() const { return FileNames; }
+
+private:
+    std::vector<std::string> FileNames;
+};
+
+std::vector<std::string> ReadAll(TRecordReader& reader) {
+    std::vector<std::string> records;
+    std::string record;
+    while (reader.Next(&record)) {
+        records.push_back(record);
+    }
+    return records;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( array_objects )
+{
+    TTempFiles files;
+    files.Add(R"([
+        {"title": "a {b} c", "text": "quote \" and brace }"},
+        {"nested": {"x": [1, {"y": "\\"}]}, "z": "\\\"}"}
+    ])");
+    TRecordReader reader(files.GetFileNames(), tg::IF_JSON);
+    const std::vector<std::string> records = ReadAll(reader);
+    BOOST_REQUIRE_EQUAL(records.size(), 2);
+    BOOST_CHECK_EQUAL(records[0], R"({"title": "a {b} c", "text": "quote \" and brace }"})");
+    BOOST_CHECK_EQUAL(records[1], R"({"nested": {"x": [1, {"y": "\\"}]}, "z": "\\\"}"})");
+}
+
+BOOST_AUTO_TEST_CASE( several_files )
+{
+    TTempFiles files;
+    files.Add(R"([{"id": 1}, {"id": 2}])");
+    files.Add("[]");
+    files.Add(R"([{"id": 3}])");
+    TRecordReader reader(files.GetFileNames(), tg::IF_JSON);
+    BOOST_CHECK((ReadAll(reader) == std::vector<std::string>{R"({"id": 1})", R"({"id": 2})", R"({"id": 3})"}));
+
+    std::string record;
+    BOOST_CHECK(!reader.Next(&record));
+}
+
+BOOST_AUTO_TEST_CASE( truncated_array )
+{
+    TTempFiles files;
+    files.Add(R"([{"id": 1}, {"id": 2, "text": "}")");
+    TRecordReader reader(files.GetFileNames(), tg::IF_JSON);
+    std::string record;
+    BOOST_REQUIRE(reader.Next(&record));
+    BOOST_CHECK_EQUAL(record, R"({"id": 1})");
+    BOOST_CHECK_THROW(reader.Next(&record), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( jsonl_lines )
+{
+    TTempFiles files;
+    files.Add("{\"id\": 1}\n\n{\"id\": 2}\n");
+    files.Add("{\"id\": 3}");
+    TRecordReader reader(files.GetFileNames(), tg::IF_JSONL);
+    BOOST_CHECK((ReadAll(reader) == std::vector<std::string>{R"({"id": 1})", R"({"id": 2})", R"({"id": 3})"}));
+}
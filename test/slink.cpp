@@ -0,0 +1,135 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "SlinkModule"
+
+#include "../src/clustering/slink.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+using TPartition = std::set<std::set<std::string>>;
+
+const size_t EMBEDDING_SIZE = 32;
+
+// Documents go from the freshest to the oldest, documents of a topic are consecutive in time
+std::vector<TDbDocument> MakeDocuments(size_t topicsCount, size_t topicSize, size_t firstId) {
+    std::mt19937 rng(static_cast<unsigned>(firstId));
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+    std::vector<TDbDocument> docs;
+    for (size_t topic = 0; topic < topicsCount; ++topic) {
+        for (size_t i = 0; i < topicSize; ++i) {
+            const size_t id = firstId + docs.size();
+            TDbDocument doc;
+            doc.FileName = std::to_string(id) + ".html";
+            doc.SiteName = "site" + std::to_string(id);
+            doc.FetchTime = 1000000 - id;
+            std::vector<float> embedding(EMBEDDING_SIZE);
+            for (float& value : embedding) {
+                value = noise(rng);
+            }
+            embedding[topic % EMBEDDING_SIZE] += 1.0f;
+            doc.Embeddings[tg::EK_FASTTEXT_CLASSIC] = embedding;
+            docs.push_back(doc);
+        }
+    }
+    return docs;
+}
+
+tg::TClusteringConfig MakeConfig(size_t largeClusterSize) {
+    tg::TClusteringConfig config;
+    config.set_small_threshold(0.05f);
+    config.set_small_cluster_size(largeClusterSize);
+    config.set_medium_threshold(0.05f);
+    config.set_medium_cluster_size(largeClusterSize);
+    config.set_large_threshold(0.05f);
+    config.set_large_cluster_size(largeClusterSize);
+    config.set_intersection_size(10);
+    config.set_ban_same_hosts(true);
+    auto* keyWeight = config.add_embedding_keys_weights();
+    keyWeight->set_embedding_key(tg::EK_FASTTEXT_CLASSIC);
+    keyWeight->set_weight(1.0f);
+    return config;
+}
+
+TPartition ToPartition(const TClusters& clusters) {
+    TPartition partition;
+    for (const TNewsCluster& cluster : clusters) {
+        std::set<std::string> fileNames;
+        for (const TDbDocument& doc : cluster.GetDocuments()) {
+            fileNames.insert(doc.FileName);
+        }
+        partition.insert(fileNames);
+    }
+    return partition;
+}
+
+// Old documents are clustered fully, then new documents are added to the head
+TClusters ClusterIncrementally(
+    TSlinkClustering& clustering,
+    const std::vector<TDbDocument>& newDocs,
+    const std::vector<TDbDocument>& oldDocs)
+{
+    TClusteringState state;
+    clustering.Cluster(std::make_shared<TDocumentArena>(std::vector<TDbDocument>(oldDocs)), state);
+    std::vector<TDbDocument> docs = newDocs;
+    docs.insert(docs.end(), oldDocs.begin(), oldDocs.end());
+    return clustering.Cluster(std::make_shared<TDocumentArena>(std::move(docs)), state);
+}
+
+void CheckLimits(const TClusters& clusters, size_t largeClusterSize, size_t docsCount) {
+    size_t clusteredCount = 0;
+    for (const TNewsCluster& cluster : clusters) {
+        BOOST_CHECK_LE(cluster.GetSize(), largeClusterSize);
+        std::set<std::string> siteNames;
+        for (const TDbDocument& doc : cluster.GetDocuments()) {
+            BOOST_CHECK(siteNames.insert(doc.SiteName).second);
+        }
+        clusteredCount += cluster.GetSize();
+    }
+    BOOST_CHECK_EQUAL(clusteredCount, docsCount);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( incremental_same_as_full )
+{
+    TSlinkClustering clustering(MakeConfig(100));
+
+    // New documents belong to the freshest old topic, which fits into the intersection
+    std::vector<TDbDocument> newDocs = MakeDocuments(1, 3, 0);
+    std::vector<TDbDocument> oldDocs = MakeDocuments(20, 5, newDocs.size());
+    const TClusters incrementalClusters = ClusterIncrementally(clustering, newDocs, oldDocs);
+
+    std::vector<TDbDocument> docs = newDocs;
+    docs.insert(docs.end(), oldDocs.begin(), oldDocs.end());
+    const TClusters fullClusters = clustering.Cluster(std::make_shared<TDocumentArena>(std::move(docs)));
+
+    BOOST_CHECK_EQUAL(fullClusters.size(), 20);
+    BOOST_CHECK(ToPartition(incrementalClusters) == ToPartition(fullClusters));
+}
+
+BOOST_AUTO_TEST_CASE( incremental_limits )
+{
+    // The second old topic is split by the intersection, its tail does not fit into the joined cluster
+    std::vector<TDbDocument> newDocs = MakeDocuments(2, 3, 0);
+    std::vector<TDbDocument> oldDocs = MakeDocuments(3, 8, newDocs.size());
+    {
+        TSlinkClustering clustering(MakeConfig(6));
+        CheckLimits(ClusterIncrementally(clustering, newDocs, oldDocs), 6, newDocs.size() + oldDocs.size());
+    }
+
+    // The tail has the same host as a new document
+    newDocs.back().SiteName = oldDocs[15].SiteName;
+    {
+        TSlinkClustering clustering(MakeConfig(100));
+        const TClusters clusters = ClusterIncrementally(clustering, newDocs, oldDocs);
+        CheckLimits(clusters, 100, newDocs.size() + oldDocs.size());
+        BOOST_CHECK_EQUAL(clusters.size(), 4);
+    }
+}
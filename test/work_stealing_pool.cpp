@@ -0,0 +1,108 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "WorkStealingPoolModule"
+
+#include "../src/work_stealing_pool.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE( parallel_for )
+{
+    TWorkStealingPool pool(4);
+    for (size_t grainSize : {1, 3, 100, 1000}) {
+        std::vector<int> calls(1000, 0);
+        pool.ParallelFor(0, calls.size(), [&calls](size_t i) {
+            ++calls[i];
+        }, grainSize);
+        for (int count : calls) {
+            BOOST_CHECK_EQUAL(count, 1);
+        }
+    }
+
+    // The range is [begin, end), an empty range calls nothing
+    std::vector<int> calls(10, 0);
+    pool.ParallelFor(3, 7, [&calls](size_t i) { ++calls[i]; });
+    BOOST_CHECK((calls == std::vector<int>{0, 0, 0, 1, 1, 1, 1, 0, 0, 0}));
+    pool.ParallelFor(5, 5, [&calls](size_t i) { ++calls[i]; });
+    pool.ParallelFor(6, 5, [&calls](size_t i) { ++calls[i]; });
+    BOOST_CHECK((calls == std::vector<int>{0, 0, 0, 1, 1, 1, 1, 0, 0, 0}));
+}
+
+BOOST_AUTO_TEST_CASE( parallel_for_without_threads )
+{
+    // The calling thread processes all chunks
+    TWorkStealingPool pool(0);
+    std::vector<int> calls(100, 0);
+    pool.ParallelFor(0, calls.size(), [&calls](size_t i) { ++calls[i]; }, 7);
+    for (int count : calls) {
+        BOOST_CHECK_EQUAL(count, 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( nested_parallel_for )
+{
+    // Inner loops run in the workers of the outer one and must not deadlock
+    TWorkStealingPool pool(2);
+    const size_t outerSize = 16;
+    const size_t innerSize = 100;
+    std::vector<std::atomic<int>> calls(outerSize * innerSize);
+    pool.ParallelFor(0, outerSize, [&](size_t i) {
+        pool.ParallelFor(0, innerSize, [&](size_t j) {
+            calls[i * innerSize + j].fetch_add(1);
+        }, 5);
+    });
+    for (const auto& count : calls) {
+        BOOST_CHECK_EQUAL(count.load(), 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( parallel_for_exception )
+{
+    TWorkStealingPool pool(4);
+    std::atomic<size_t> callsCount {0};
+    BOOST_CHECK_THROW(pool.ParallelFor(0, 1000, [&callsCount](size_t i) {
+        callsCount.fetch_add(1);
+        if (i == 10) {
+            throw std::runtime_error("failed");
+        }
+    }), std::runtime_error);
+    BOOST_CHECK_LE(callsCount.load(), 1000);
+
+    // The pool is usable after a failed loop
+    std::atomic<size_t> sum {0};
+    pool.ParallelFor(0, 100, [&sum](size_t i) { sum.fetch_add(i); });
+    BOOST_CHECK_EQUAL(sum.load(), 4950);
+}
+
+BOOST_AUTO_TEST_CASE( submit )
+{
+    TWorkStealingPool pool(3);
+    const size_t tasksCount = 100;
+    std::atomic<size_t> doneCount {0};
+    std::promise<void> allDone;
+    for (size_t i = 0; i < tasksCount; ++i) {
+        pool.Submit([&] {
+            if (doneCount.fetch_add(1) + 1 == tasksCount) {
+                allDone.set_value();
+            }
+        });
+    }
+    // Large tasks are stored on the heap
+    std::vector<int> payload(64, 1);
+    std::promise<int> largeDone;
+    pool.Submit([payload, &largeDone] {
+        int sum = 0;
+        for (int value : payload) {
+            sum += value;
+        }
+        largeDone.set_value(sum);
+    });
+    allDone.get_future().wait();
+    BOOST_CHECK_EQUAL(doneCount.load(), tasksCount);
+    BOOST_CHECK_EQUAL(largeDone.get_future().get(), 64);
+}